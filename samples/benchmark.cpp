@@ -0,0 +1,1298 @@
+#include "../src/tinyjson.h"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+using namespace tinyjson;
+
+//
+// every heap allocation of the process is counted, so the figures below
+// include std::map nodes, std::string buffers and container growth. The reclaimer
+// frees on a thread of its own, hence the atomics.
+//
+static std::atomic<size_t> g_live_bytes{0};
+static std::atomic<size_t> g_live_allocations{0};
+static std::atomic<size_t> g_total_allocations{0};
+
+// each block carries its size so the live byte count can be kept exact
+static constexpr size_t block_header = alignof(std::max_align_t);
+
+void* operator new(size_t size)
+{
+    char* block = static_cast<char*>(std::malloc(size + block_header));
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    *reinterpret_cast<size_t*>(block) = size;
+    g_live_bytes += size;
+    g_live_allocations++;
+    g_total_allocations++;
+    return block + block_header;
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+
+    char* block = static_cast<char*>(p) - block_header;
+    g_live_bytes -= *reinterpret_cast<size_t*>(block);
+    g_live_allocations--;
+    std::free(block);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+
+struct heap_snapshot
+{
+    size_t bytes;
+    size_t allocations;
+
+    static heap_snapshot now() { return heap_snapshot{g_live_bytes, g_live_allocations}; }
+};
+
+// packed numeric arrays hold no json elements to walk
+static bool is_packed(const json& j)
+{
+    return j.is_packed<long long>() || j.is_packed<double>();
+}
+
+static size_t count_nodes(const json& j)
+{
+    size_t nodes = 1;
+
+    if (is_packed(j))
+    {
+        nodes += j.size();
+    }
+    else if (j.type() == json_t::array)
+    {
+        for (auto& elem : j)
+        {
+            nodes += count_nodes(elem);
+        }
+    }
+    else if (j.type() == json_t::object)
+    {
+        for (auto& [key, value] : j.items())
+        {
+            nodes += count_nodes(value);
+        }
+    }
+
+    return nodes;
+}
+
+// touches every key and value of the document through the const accessors
+static size_t visit(const json& j)
+{
+    switch (j.type())
+    {
+        case json_t::string:
+            return j.get_string_view().size();
+
+        case json_t::number_integer:
+            return (size_t)j.get_integer();
+
+        case json_t::number_double:
+            return (size_t)j.get_double();
+
+        case json_t::boolean:
+            return j.get_bool() ? 1 : 0;
+
+        case json_t::array:
+        {
+            size_t sum = 0;
+
+            // packed numbers are read in place
+            if (j.is_packed<long long>())
+            {
+                for (long long val : j.as_span<long long>())
+                {
+                    sum += (size_t)val;
+                }
+                return sum;
+            }
+            if (j.is_packed<double>())
+            {
+                for (double val : j.as_span<double>())
+                {
+                    sum += (size_t)val;
+                }
+                return sum;
+            }
+
+            for (size_t i = 0; i < j.size(); i++)
+            {
+                sum += visit(j[(int)i]);
+            }
+            return sum;
+        }
+
+        case json_t::object:
+        {
+            size_t sum = 0;
+            for (auto& [key, value] : j.items())
+            {
+                sum += key.size() + visit(j[key]);
+            }
+            return sum;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static std::string read_file(const char* path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("cannot open " + std::string(path));
+    }
+
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static const char* default_corpus = R"(
+    {"widget": {
+        "debug": "on",
+        "window": {
+            "title": "Sample Konfabulator Widget",
+            "name": "main_window",
+            "width": 500,
+            "height": 500
+        },
+        "image": {
+            "src": "Images/Sun.png",
+            "name": "sun1",
+            "hOffset": 250,
+            "vOffset": 250,
+            "alignment": "center"
+        },
+        "text": {
+            "data": "Click Here",
+            "size": 36,
+            "style": "bold",
+            "name": "text1",
+            "hOffset": 250,
+            "vOffset": 100,
+            "alignment": "center",
+            "onMouseUp": "sun1.opacity = (sun1.opacity / 100) * 90;"
+        }
+    }})";
+
+// the other documents of samples/main.cpp
+static const char* menu_corpus = R"DDR(
+    {"menu": {
+    "id": "file",
+    "value": "File",
+    "popup": {
+        "menuitem": [
+        {"value": "New", "onclick": "CreateNewDoc()"},
+        {"value": "Open", "onclick": "OpenDoc()"},
+        {"value": "Close", "onclick": "CloseDoc()"}
+        ]
+    }
+    }})DDR";
+
+static const char* web_app_corpus = R"DDR(
+    {"web-app": {
+    "servlet": [
+        {
+        "servlet-name": "cofaxCDS",
+        "servlet-class": "org.cofax.cds.CDSServlet",
+        "init-param": {
+            "configGlossary:installationAt": "Philadelphia, PA",
+            "configGlossary:adminEmail": "ksm@pobox.com",
+            "configGlossary:poweredBy": "Cofax",
+            "configGlossary:poweredByIcon": "/images/cofax.gif",
+            "configGlossary:staticPath": "/content/static",
+            "templateProcessorClass": "org.cofax.WysiwygTemplate",
+            "templateLoaderClass": "org.cofax.FilesTemplateLoader",
+            "templatePath": "templates",
+            "templateOverridePath": "",
+            "defaultListTemplate": "listTemplate.htm",
+            "defaultFileTemplate": "articleTemplate.htm",
+            "useJSP": false,
+            "jspListTemplate": "listTemplate.jsp",
+            "jspFileTemplate": "articleTemplate.jsp",
+            "cachePackageTagsTrack": 200,
+            "cachePackageTagsStore": 200,
+            "cachePackageTagsRefresh": 60,
+            "cacheTemplatesTrack": 100,
+            "cacheTemplatesStore": 50,
+            "cacheTemplatesRefresh": 15,
+            "cachePagesTrack": 200,
+            "cachePagesStore": 100,
+            "cachePagesRefresh": 10,
+            "cachePagesDirtyRead": 10,
+            "searchEngineListTemplate": "forSearchEnginesList.htm",
+            "searchEngineFileTemplate": "forSearchEngines.htm",
+            "searchEngineRobotsDb": "WEB-INF/robots.db",
+            "useDataStore": true,
+            "dataStoreClass": "org.cofax.SqlDataStore",
+            "redirectionClass": "org.cofax.SqlRedirection",
+            "dataStoreName": "cofax",
+            "dataStoreDriver": "com.microsoft.jdbc.sqlserver.SQLServerDriver",
+            "dataStoreUrl": "jdbc:microsoft:sqlserver://LOCALHOST:1433;DatabaseName=goon",
+            "dataStoreUser": "sa",
+            "dataStorePassword": "dataStoreTestQuery",
+            "dataStoreTestQuery": "SET NOCOUNT ON;select test='test';",
+            "dataStoreLogFile": "/usr/local/tomcat/logs/datastore.log",
+            "dataStoreInitConns": 10,
+            "dataStoreMaxConns": 100,
+            "dataStoreConnUsageLimit": 100,
+            "dataStoreLogLevel": "debug",
+            "maxUrlLength": 500}},
+        {
+        "servlet-name": "cofaxEmail",
+        "servlet-class": "org.cofax.cds.EmailServlet",
+        "init-param": {
+        "mailHost": "mail1",
+        "mailHostOverride": "mail2"}},
+        {
+        "servlet-name": "cofaxAdmin",
+        "servlet-class": "org.cofax.cds.AdminServlet"},
+
+        {
+        "servlet-name": "fileServlet",
+        "servlet-class": "org.cofax.cds.FileServlet"},
+        {
+        "servlet-name": "cofaxTools",
+        "servlet-class": "org.cofax.cms.CofaxToolsServlet",
+        "init-param": {
+            "templatePath": "toolstemplates/",
+            "log": 1,
+            "logLocation": "/usr/local/tomcat/logs/CofaxTools.log",
+            "logMaxSize": "",
+            "dataLog": 1,
+            "dataLogLocation": "/usr/local/tomcat/logs/dataLog.log",
+            "dataLogMaxSize": "",
+            "removePageCache": "/content/admin/remove?cache=pages&id=",
+            "removeTemplateCache": "/content/admin/remove?cache=templates&id=",
+            "fileTransferFolder": "/usr/local/tomcat/webapps/content/fileTransferFolder",
+            "lookInContext": 1,
+            "adminGroupID": 4,
+            "betaServer": true}}],
+    "servlet-mapping": {
+        "cofaxCDS": "/",
+        "cofaxEmail": "/cofaxutil/aemail/*",
+        "cofaxAdmin": "/admin/*",
+        "fileServlet": "/static/*",
+        "cofaxTools": "/tools/*"},
+
+    "taglib": {
+        "taglib-uri": "cofax.tld",
+        "taglib-location": "/WEB-INF/tlds/cofax.tld"}}})DDR";
+
+//
+// string allocations of a document, and what they were when every string value
+// was a heap allocated std::string (plus its buffer when longer than its own SSO)
+//
+struct string_stats
+{
+    size_t values = 0;
+    size_t inline_values = 0;
+    size_t keys = 0;
+    size_t inline_keys = 0;
+    size_t allocations = 0;
+    size_t legacy_allocations = 0;
+};
+
+static void count_strings(const json& j, string_stats& stats)
+{
+    const size_t sso_capacity = json::string_t().capacity();
+
+    if (j.type() == json_t::string)
+    {
+        size_t length = j.get_string_view().size();
+        bool buffer = length > sso_capacity;
+
+        stats.values++;
+        stats.legacy_allocations += 1 + (buffer ? 1 : 0);
+        if (length <= json::short_string_capacity)
+        {
+            stats.inline_values++;
+        }
+        else
+        {
+            // the shared payload, then the string buffer
+            stats.allocations += 1 + (buffer ? 1 : 0);
+        }
+    }
+    else if (j.type() == json_t::array && !is_packed(j))
+    {
+        for (auto& elem : j)
+        {
+            count_strings(elem, stats);
+        }
+    }
+    else if (j.type() == json_t::object)
+    {
+        for (auto& [key, value] : j.items())
+        {
+            // keys are stored the same way as before
+            bool buffer = key.size() > sso_capacity;
+            stats.keys++;
+            stats.inline_keys += buffer ? 0 : 1;
+            stats.allocations += buffer ? 1 : 0;
+            stats.legacy_allocations += buffer ? 1 : 0;
+            count_strings(value, stats);
+        }
+    }
+}
+
+static void bench_strings(const json& doc)
+{
+    string_stats stats;
+    count_strings(doc, stats);
+
+    std::cout << std::left << std::setw(24) << "  strings"
+              << " values: " << std::setw(8) << stats.values
+              << " inline: " << std::setw(8) << stats.inline_values
+              << " keys: " << std::setw(8) << stats.keys
+              << " inline: " << std::setw(8) << stats.inline_keys
+              << " allocs: " << stats.allocations
+              << " (was " << stats.legacy_allocations << ")"
+              << std::endl;
+}
+
+// what the document reports about itself, next to what the heap counters saw
+static void bench_usage(const json& doc, size_t nodes, size_t heap_bytes)
+{
+    memory_usage_t usage = doc.memory_usage();
+
+    std::cout << std::left << std::setw(24) << "  memory_usage"
+              << " bytes/node: " << std::setw(8) << std::setprecision(4) << (double)usage.total / nodes
+              << " values: " << usage.values
+              << " strings: " << usage.strings
+              << " keys: " << usage.keys
+              << " containers: " << usage.containers
+              << " packed: " << usage.packed
+              << (usage.total - sizeof(json) == heap_bytes ? "" : " (heap differs)")
+              << std::endl;
+}
+
+static void bench_traversal(const json& doc, size_t nodes)
+{
+    const int rounds = 10;
+
+    size_t allocations_before = g_total_allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    size_t checksum = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        checksum += visit(doc);
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    size_t allocations = g_total_allocations - allocations_before;
+
+    std::cout << std::left << std::setw(24) << "  traversal"
+              << " ns/node: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::nano>(stop - start).count() / (nodes * rounds)
+              << " allocs/access: " << std::setw(8) << (double)allocations / (nodes * rounds)
+              << " checksum: " << checksum
+              << std::endl;
+}
+
+// looks every member up by key, in the json tree and in its frozen copy
+static size_t lookup_all(const json& j)
+{
+    size_t sum = 0;
+    if (j.type() == json_t::object)
+    {
+        for (auto& [key, value] : j.items())
+        {
+            sum += j[key].type() + lookup_all(value);
+        }
+    }
+    else if (j.type() == json_t::array && !is_packed(j))
+    {
+        for (auto& elem : j)
+        {
+            sum += lookup_all(elem);
+        }
+    }
+    return sum;
+}
+
+static size_t lookup_all(const json& j, frozen_json::value f)
+{
+    size_t sum = 0;
+    if (j.type() == json_t::object)
+    {
+        for (auto& [key, value] : j.items())
+        {
+            sum += f[key].type() + lookup_all(value, f[key]);
+        }
+    }
+    else if (j.type() == json_t::array && !is_packed(j))
+    {
+        for (int i = 0; i < (int)j.size(); i++)
+        {
+            sum += lookup_all(j[i], f[i]);
+        }
+    }
+    return sum;
+}
+
+static void bench_lookup(const json& doc)
+{
+    const int rounds = 10;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t tree_sum = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        tree_sum += lookup_all(doc);
+    }
+    auto tree_stop = std::chrono::steady_clock::now();
+
+    frozen_json frozen = doc.freeze();
+    auto frozen_start = std::chrono::steady_clock::now();
+    size_t frozen_sum = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        // the walk itself goes through the tree, so the difference is the lookup cost
+        frozen_sum += lookup_all(doc, frozen.root());
+    }
+    auto frozen_stop = std::chrono::steady_clock::now();
+
+    std::cout << std::left << std::setw(24) << "  lookup"
+              << " tree ms: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::milli>(tree_stop - start).count()
+              << " tree+frozen ms: " << std::setw(8)
+              << std::chrono::duration<double, std::milli>(frozen_stop - frozen_start).count()
+              << " frozen bytes: " << frozen.block_size()
+              << (tree_sum == frozen_sum ? "" : " MISMATCH")
+              << std::endl;
+}
+
+// the same walk as visit, sequentially over a tape
+static size_t visit(tape_document::element e)
+{
+    switch (e.type())
+    {
+        case json_t::string:
+            return e.get_string_view().size();
+
+        case json_t::number_integer:
+            return (size_t)e.get_integer();
+
+        case json_t::number_double:
+            return (size_t)e.get_double();
+
+        case json_t::boolean:
+            return e.get_bool() ? 1 : 0;
+
+        case json_t::array:
+        {
+            size_t sum = 0;
+            for (auto elem : e)
+            {
+                sum += visit(elem);
+            }
+            return sum;
+        }
+
+        case json_t::object:
+        {
+            size_t sum = 0;
+            for (auto it = e.begin(), end = e.end(); it != end; ++it)
+            {
+                sum += it.key().size() + visit(*it);
+            }
+            return sum;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void bench_tape(const std::string& text, size_t nodes)
+{
+    const int rounds = 10;
+
+    heap_snapshot before = heap_snapshot::now();
+    auto start = std::chrono::steady_clock::now();
+
+    tape_document doc = tape_document::parse(text);
+
+    auto stop = std::chrono::steady_clock::now();
+    heap_snapshot after = heap_snapshot::now();
+
+    auto visit_start = std::chrono::steady_clock::now();
+    size_t checksum = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        checksum += visit(doc.root());
+    }
+    auto visit_stop = std::chrono::steady_clock::now();
+
+    std::cout << std::left << std::setw(24) << "  tape"
+              << " parse ms: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::milli>(stop - start).count()
+              << " bytes/node: " << std::setw(8) << (double)(after.bytes - before.bytes) / nodes
+              << " allocs: " << std::setw(4) << after.allocations - before.allocations
+              << " ns/node: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(visit_stop - visit_start).count() / (nodes * rounds)
+              << " checksum: " << checksum
+              << std::endl;
+}
+
+// hashes the tree once, again from the kept hashes, and the old way through to_string
+static void bench_hash(const json& doc, size_t nodes)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t first = doc.hash();
+    auto first_stop = std::chrono::steady_clock::now();
+    size_t again = doc.hash();
+    auto again_stop = std::chrono::steady_clock::now();
+    size_t text = std::hash<std::string>()(doc.to_string());
+    auto text_stop = std::chrono::steady_clock::now();
+
+    std::cout << std::left << std::setw(24) << "  hash"
+              << " first ns/node: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::nano>(first_stop - start).count() / nodes
+              << " cached ns: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(again_stop - first_stop).count()
+              << " to_string ns/node: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(text_stop - again_stop).count() / nodes
+              << (first == again ? "" : " (hash differs)")
+              << std::endl;
+    (void)text;
+}
+
+// compares two separately parsed copies, equal and then differing in their first member or element
+static void bench_equality(const std::string& text, size_t nodes)
+{
+    json a = parser::parse(text.c_str());
+    json b = parser::parse(text.c_str());
+
+    auto start = std::chrono::steady_clock::now();
+    bool equal = (a == b);
+    auto equal_stop = std::chrono::steady_clock::now();
+
+    if (b.type() == json_t::object && b.size() > 0)
+    {
+        b.items().begin()->second = json();
+    }
+    else if (b.type() == json_t::array && b.size() > 0)
+    {
+        b[0] = json();
+    }
+
+    auto unequal_start = std::chrono::steady_clock::now();
+    bool unequal = (a != b);
+    auto unequal_stop = std::chrono::steady_clock::now();
+
+    std::cout << std::left << std::setw(24) << "  equality"
+              << " equal ns/node: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::nano>(equal_stop - start).count() / nodes
+              << " first differs ns: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(unequal_stop - unequal_start).count()
+              << (equal && unequal ? "" : " (wrong result)")
+              << std::endl;
+}
+
+// serializes through to_string, and into one buffer reused across rounds
+static void bench_serialize(const json& doc)
+{
+    const int rounds = 5;
+
+    size_t allocations_before = g_total_allocations;
+    auto start = std::chrono::steady_clock::now();
+    size_t length = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        length = doc.to_string().size();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    size_t allocations = g_total_allocations - allocations_before;
+
+    std::string buffer;
+    size_t reused_before = 0;
+    auto reused_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        // the first round grows the buffer, the others only reuse it
+        reused_before = (i == 1) ? g_total_allocations.load() : reused_before;
+        buffer.clear();
+        string_sink<> out(buffer);
+        doc.dump(out);
+    }
+    auto reused_stop = std::chrono::steady_clock::now();
+    size_t reused_allocations = g_total_allocations - reused_before;
+
+    // pretty text into the same buffer, measured by the bytes it writes
+    dump_options pretty;
+    pretty.pretty = true;
+    size_t pretty_length = 0;
+    auto pretty_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        buffer.clear();
+        string_sink<> out(buffer);
+        doc.dump(out, pretty);
+        pretty_length = buffer.size();
+    }
+    auto pretty_stop = std::chrono::steady_clock::now();
+
+    double mb = (double)length * rounds / (1024 * 1024);
+    std::cout << std::left << std::setw(24) << "  serialize"
+              << " to_string MB/s: " << std::setw(8) << std::setprecision(4)
+              << mb / std::chrono::duration<double>(stop - start).count()
+              << " allocs: " << std::setw(8) << allocations / rounds
+              << " reused buffer MB/s: " << std::setw(8)
+              << mb / std::chrono::duration<double>(reused_stop - reused_start).count()
+              << " allocs: " << std::setw(8) << reused_allocations
+              << " pretty MB/s: " << std::setw(8)
+              << (double)pretty_length * rounds / (1024 * 1024) / std::chrono::duration<double>(pretty_stop - pretty_start).count()
+              << " pretty/compact size: " << (double)pretty_length / length
+              << std::endl;
+}
+
+static void collect_numbers(const json& j, std::vector<long long>& integers, std::vector<double>& doubles)
+{
+    if (j.is_packed<long long>())
+    {
+        for (long long val : j.as_span<long long>())
+        {
+            integers.push_back(val);
+        }
+    }
+    else if (j.is_packed<double>())
+    {
+        for (double val : j.as_span<double>())
+        {
+            doubles.push_back(val);
+        }
+    }
+    else if (j.type() == json_t::number_integer)
+    {
+        integers.push_back(j.get_integer());
+    }
+    else if (j.type() == json_t::number_double)
+    {
+        doubles.push_back(j.get_double());
+    }
+    else if (j.type() == json_t::array)
+    {
+        for (auto& elem : j)
+        {
+            collect_numbers(elem, integers, doubles);
+        }
+    }
+    else if (j.type() == json_t::object)
+    {
+        for (auto& [key, value] : j.items())
+        {
+            collect_numbers(value, integers, doubles);
+        }
+    }
+}
+
+static void collect_strings(const json& j, std::vector<std::string_view>& out)
+{
+    if (j.type() == json_t::string)
+    {
+        out.push_back(j.get_string_view());
+    }
+    else if (j.type() == json_t::array && !is_packed(j))
+    {
+        for (auto& elem : j)
+        {
+            collect_strings(elem, out);
+        }
+    }
+    else if (j.type() == json_t::object)
+    {
+        for (auto& [key, value] : j.items())
+        {
+            out.push_back(std::string_view(key.data(), key.size()));
+            collect_strings(value, out);
+        }
+    }
+}
+
+// what escaping cost before the 16 byte scan: one test and one put per byte
+static void escape_bytewise(output_sink& out, std::string_view s)
+{
+    out.put('"');
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out.put('\\');
+            out.put(c);
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char text[8];
+            out.write(text, std::snprintf(text, sizeof(text), "\\u%04x", c));
+        }
+        else
+        {
+            out.put(c);
+        }
+    }
+    out.put('"');
+}
+
+// writes every key and string value of the document, escaped, into one reused buffer
+static void bench_escape(const json& doc)
+{
+    std::vector<std::string_view> strings;
+    collect_strings(doc, strings);
+
+    size_t bytes = 0;
+    for (std::string_view s : strings)
+    {
+        bytes += s.size();
+    }
+    if (bytes == 0)
+    {
+        return;
+    }
+
+    const int rounds = 5;
+    std::string buffer;
+    auto time = [&](auto write) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++)
+        {
+            buffer.clear();
+            string_sink<> out(buffer);
+            for (std::string_view s : strings)
+            {
+                write(out, s);
+            }
+        }
+        double mb = (double)bytes * rounds / (1024 * 1024);
+        return mb / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    double scan = time([](output_sink& out, std::string_view s) { detail::write_string(out, s); });
+    std::string scanned = buffer;
+    double ascii = time([](output_sink& out, std::string_view s) { detail::write_string(out, s, true); });
+    double bytewise = time(escape_bytewise);
+
+    std::cout << std::left << std::setw(24) << "  escape"
+              << " scan MB/s: " << std::setw(8) << std::setprecision(4) << scan
+              << " ascii only MB/s: " << std::setw(8) << ascii
+              << " bytewise MB/s: " << std::setw(8) << bytewise
+              << " avg length: " << (double)bytes / strings.size()
+              << (scanned == buffer ? "" : " (text differs)")
+              << std::endl;
+}
+
+// formats every integer of the document with the digit pair formatter, std::to_chars,
+// and std::to_string, which allocates when the text outgrows its small buffer
+static void bench_integers(const std::vector<long long>& values)
+{
+    if (values.empty())
+    {
+        return;
+    }
+
+    const int rounds = 5;
+    char text[24];
+    size_t length = 0;
+    bool same = true;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        length = 0;
+        for (long long val : values)
+        {
+            length += detail::format_integer(text, val) - text;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    size_t chars_length = 0;
+    auto chars_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        chars_length = 0;
+        for (long long val : values)
+        {
+            chars_length += std::to_chars(text, text + sizeof(text), val).ptr - text;
+        }
+    }
+    auto chars_stop = std::chrono::steady_clock::now();
+
+    size_t string_length = 0;
+    auto string_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        string_length = 0;
+        for (long long val : values)
+        {
+            string_length += std::to_string(val).size();
+        }
+    }
+    auto string_stop = std::chrono::steady_clock::now();
+
+    for (long long val : values)
+    {
+        same = same && std::string(text, detail::format_integer(text, val)) == std::to_string(val);
+    }
+
+    double count = (double)values.size() * rounds;
+    std::cout << std::left << std::setw(24) << "  integers"
+              << " digit pairs ns/number: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::nano>(stop - start).count() / count
+              << " to_chars ns: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(chars_stop - chars_start).count() / count
+              << " to_string ns: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(string_stop - string_start).count() / count
+              << " chars: " << (double)length / values.size()
+              << (same && length == chars_length && length == string_length ? "" : " (text differs)")
+              << std::endl;
+}
+
+// formats every double of the document as the shortest text, and as %.17g, the
+// shortest printf precision that always reads back
+static void bench_doubles(const std::vector<double>& values)
+{
+    if (values.empty())
+    {
+        return;
+    }
+
+    const int rounds = 5;
+    char text[detail::max_double_chars];
+    size_t length = 0;
+    bool round_trip = true;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        length = 0;
+        for (double val : values)
+        {
+            length += detail::format_double(text, val) - text;
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    size_t printf_length = 0;
+    auto printf_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        printf_length = 0;
+        for (double val : values)
+        {
+            printf_length += std::snprintf(text, sizeof(text), "%.17g", val);
+        }
+    }
+    auto printf_stop = std::chrono::steady_clock::now();
+
+    for (double val : values)
+    {
+        *detail::format_double(text, val) = '\0';
+        round_trip = round_trip && std::strtod(text, nullptr) == val;
+    }
+
+    double count = (double)values.size() * rounds;
+    std::cout << std::left << std::setw(24) << "  doubles"
+              << " shortest ns/number: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::nano>(stop - start).count() / count
+              << " chars: " << std::setw(8) << (double)length / values.size()
+              << " %.17g ns/number: " << std::setw(8)
+              << std::chrono::duration<double, std::nano>(printf_stop - printf_start).count() / count
+              << " chars: " << (double)printf_length / values.size()
+              << (round_trip ? "" : " (round trip failed)")
+              << std::endl;
+}
+
+// sizes the text up front, then writes it into one exactly sized buffer
+static void bench_sized(const json& doc)
+{
+    const int rounds = 5;
+
+    size_t size = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        size = doc.serialized_size();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    std::unique_ptr<char[]> buffer(new char[size]);
+    size_t written = 0;
+    auto write_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        written = doc.serialize_to(buffer.get(), size) - buffer.get();
+    }
+    auto write_stop = std::chrono::steady_clock::now();
+
+    double mb = (double)size * rounds / (1024 * 1024);
+    std::cout << std::left << std::setw(24) << "  sized"
+              << " size pass MB/s: " << std::setw(8) << std::setprecision(4)
+              << mb / std::chrono::duration<double>(stop - start).count()
+              << " serialize_to MB/s: " << std::setw(8)
+              << mb / std::chrono::duration<double>(write_stop - write_start).count()
+              << " bytes: " << size
+              << (written == size && std::string(buffer.get(), size) == doc.to_string() ? "" : " (size differs)")
+              << std::endl;
+}
+
+// canonical text into a buffer, hashed as it streams by, and hashed after building it
+static void bench_canonical(const json& doc)
+{
+    const int rounds = 5;
+
+    std::string buffer;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        buffer.clear();
+        string_sink<> out(buffer);
+        doc.dump_canonical(out);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    const size_t length = buffer.size();
+
+    sha256_sink sha;
+    sha256_sink::digest_type streamed{};
+    size_t allocations_before = g_total_allocations;
+    auto hash_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        doc.dump_canonical(sha);
+        streamed = sha.digest();
+    }
+    auto hash_stop = std::chrono::steady_clock::now();
+    size_t allocations = g_total_allocations - allocations_before;
+
+    sha256_sink::digest_type built{};
+    auto built_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        std::string text;
+        {
+            string_sink<> out(text);
+            doc.dump_canonical(out);
+        }
+        sha.write(text);
+        built = sha.digest();
+    }
+    auto built_stop = std::chrono::steady_clock::now();
+
+    double mb = (double)length * rounds / (1024 * 1024);
+    std::cout << std::left << std::setw(24) << "  canonical"
+              << " text MB/s: " << std::setw(8) << std::setprecision(4)
+              << mb / std::chrono::duration<double>(stop - start).count()
+              << " streamed sha256 MB/s: " << std::setw(8)
+              << mb / std::chrono::duration<double>(hash_stop - hash_start).count()
+              << " allocs: " << std::setw(8) << allocations / rounds
+              << " text then sha256 MB/s: " << std::setw(8)
+              << mb / std::chrono::duration<double>(built_stop - built_start).count()
+              << (streamed == built ? "" : " (digest differs)")
+              << std::endl;
+}
+
+// sends the document to a file through to_string and one write, and through an fd sink
+static void bench_fd(const json& doc)
+{
+    std::FILE* file = std::tmpfile();
+    if (file == nullptr)
+    {
+        return;
+    }
+#ifdef _WIN32
+    int fd = _fileno(file);
+#else
+    int fd = fileno(file);
+#endif
+
+    const int rounds = 5;
+    size_t length = 0;
+    size_t string_heap = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        size_t before = g_live_bytes;
+        std::string text = doc.to_string();
+        string_heap = g_live_bytes - before;
+        length = text.size();
+
+        // what dump's fd_sink would do with a page, without its pages
+        const char* data = text.data();
+        size_t n = text.size();
+        while (n > 0)
+        {
+#ifdef _WIN32
+            int written = _write(fd, data, static_cast<unsigned int>(n));
+#else
+            ssize_t written = write(fd, data, n);
+#endif
+            if (written <= 0)
+            {
+                break;
+            }
+            data += written;
+            n -= static_cast<size_t>(written);
+        }
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    size_t allocations_before = g_total_allocations;
+    auto sink_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        fd_sink out(fd);
+        doc.dump(out);
+    }
+    auto sink_stop = std::chrono::steady_clock::now();
+    size_t sink_allocations = g_total_allocations - allocations_before;
+    std::fclose(file);
+
+    double mb = (double)length * rounds / (1024 * 1024);
+    std::cout << std::left << std::setw(24) << "  fd"
+              << " to_string+write MB/s: " << std::setw(8) << std::setprecision(4)
+              << mb / std::chrono::duration<double>(stop - start).count()
+              << " heap: " << std::setw(10) << string_heap
+              << " fd_sink MB/s: " << std::setw(8)
+              << mb / std::chrono::duration<double>(sink_stop - sink_start).count()
+              << " allocs: " << sink_allocations
+              << std::endl;
+}
+
+// frees a parsed document in place, then hands one to a reclaimer thread instead
+static void bench_teardown(const std::string& text, size_t nodes)
+{
+    auto doc = std::make_unique<json>(parser::parse(text.c_str()));
+    auto start = std::chrono::steady_clock::now();
+    doc.reset();
+    auto stop = std::chrono::steady_clock::now();
+
+    reclaimer background;
+    json retired = parser::parse(text.c_str());
+    auto retire_start = std::chrono::steady_clock::now();
+    background.retire(std::move(retired));
+    auto retire_stop = std::chrono::steady_clock::now();
+    background.drain();
+
+    std::cout << std::left << std::setw(24) << "  teardown"
+              << " ns/node: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::nano>(stop - start).count() / nodes
+              << " retire ns: "
+              << std::chrono::duration<double, std::nano>(retire_stop - retire_start).count()
+              << std::endl;
+}
+
+// parses with repeated strings, arrays and objects interned, what stays alive once the interner is gone
+static void bench_intern(const std::string& text, size_t nodes, size_t plain_bytes)
+{
+    heap_snapshot before = heap_snapshot::now();
+    auto start = std::chrono::steady_clock::now();
+
+    json doc;
+    size_t distinct = 0;
+    {
+        interner values;
+        doc = parser::parse(text.c_str(), values);
+        distinct = values.size();
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    heap_snapshot after = heap_snapshot::now();
+    size_t bytes = after.bytes - before.bytes;
+
+    std::cout << std::left << std::setw(24) << "  interned"
+              << " parse ms: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::milli>(stop - start).count()
+              << " bytes/node: " << std::setw(8) << (double)bytes / nodes
+              << " of plain: " << std::setw(8) << (double)bytes / plain_bytes
+              << " distinct: " << distinct
+              << std::endl;
+}
+
+static void bench_memory(const std::string& name, const std::string& text)
+{
+    heap_snapshot before = heap_snapshot::now();
+    size_t total_before = g_total_allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    json doc = parser::parse(text.c_str());
+
+    auto stop = std::chrono::steady_clock::now();
+    heap_snapshot after = heap_snapshot::now();
+
+    // what is still alive after parsing is the document itself
+    size_t nodes = count_nodes(doc);
+    size_t bytes = after.bytes - before.bytes;
+    size_t allocations = after.allocations - before.allocations;
+
+    std::cout << std::left << std::setw(24) << name
+              << " nodes: " << std::setw(10) << nodes
+              << " parse ms: " << std::setw(8) << std::chrono::duration<double, std::milli>(stop - start).count()
+              << " bytes/node: " << std::setw(8) << std::setprecision(4) << (double)bytes / nodes
+              << " allocs/node: " << std::setw(8) << std::setprecision(4) << (double)allocations / nodes
+              << " parse allocs/node: " << (double)(g_total_allocations - total_before) / nodes
+              << std::endl;
+
+    bench_usage(doc, nodes, bytes);
+    bench_strings(doc);
+    bench_traversal(doc, nodes);
+    bench_lookup(doc);
+    bench_tape(text, nodes);
+    bench_hash(doc, nodes);
+    bench_equality(text, nodes);
+    bench_teardown(text, nodes);
+    bench_serialize(doc);
+    bench_escape(doc);
+    bench_sized(doc);
+    bench_fd(doc);
+    bench_canonical(doc);
+
+    std::vector<long long> integers;
+    std::vector<double> doubles;
+    collect_numbers(doc, integers, doubles);
+    bench_integers(integers);
+    bench_doubles(doubles);
+
+    bench_intern(text, nodes, bytes);
+}
+
+// builds a document in place, every container is reserved and every value constructed where it lives
+static void bench_build(int count)
+{
+    size_t allocations_before = g_total_allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    json doc(json_array{});
+    doc.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        json& item = doc.emplace_element(json_object{});
+        item.emplace_member("id", i);
+        item.emplace_member("name", "item");
+        item.emplace_member("price", i * 0.25);
+        json& tags = item.emplace_member("tags", json_array{});
+        tags.reserve(2);
+        tags.emplace_element("new");
+        tags.emplace_element(i % 2 == 0);
+    }
+
+    auto stop = std::chrono::steady_clock::now();
+    size_t allocations = g_total_allocations - allocations_before;
+    size_t nodes = count_nodes(doc);
+
+    std::cout << std::left << std::setw(24) << "build"
+              << " nodes: " << std::setw(10) << nodes
+              << " build ms: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::milli>(stop - start).count()
+              << " allocs/node: " << (double)allocations / nodes
+              << std::endl;
+}
+
+//
+// usage: benchmark [corpus.json ...], e.g. canada.json twitter.json citm_catalog.json
+//
+// emits the records of bench_build as text: built as a value and serialized, and
+// through a json_writer straight into a reused buffer
+static void bench_writer(int count)
+{
+    size_t allocations_before = g_total_allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    json doc(json_array{});
+    doc.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        json& item = doc.emplace_element(json_object{});
+        item.emplace_member("id", i);
+        item.emplace_member("name", "item");
+        item.emplace_member("price", i * 0.25);
+        json& tags = item.emplace_member("tags", json_array{});
+        tags.reserve(2);
+        tags.emplace_element("new");
+        tags.emplace_element(i % 2 == 0);
+    }
+    std::string built = doc.to_string();
+
+    auto stop = std::chrono::steady_clock::now();
+    size_t allocations = g_total_allocations - allocations_before;
+
+    std::string buffer;
+    buffer.reserve(built.size());
+    allocations_before = g_total_allocations;
+    auto writer_start = std::chrono::steady_clock::now();
+    {
+        string_sink<> out(buffer);
+        json_writer writer(out);
+        writer.begin_array();
+        for (int i = 0; i < count; i++)
+        {
+            writer.begin_object()
+                .key("id").value(i)
+                .key("name").value("item")
+                .key("price").value(i * 0.25)
+                .key("tags").begin_array().value("new").value(i % 2 == 0).end_array()
+                .end_object();
+        }
+        writer.end_array();
+    }
+    auto writer_stop = std::chrono::steady_clock::now();
+    size_t writer_allocations = g_total_allocations - allocations_before;
+
+    std::cout << std::left << std::setw(24) << "writer"
+              << " records: " << std::setw(8) << count
+              << " build+to_string ms: " << std::setw(8) << std::setprecision(4)
+              << std::chrono::duration<double, std::milli>(stop - start).count()
+              << " allocs/record: " << std::setw(8) << (double)allocations / count
+              << " json_writer ms: " << std::setw(8)
+              << std::chrono::duration<double, std::milli>(writer_stop - writer_start).count()
+              << " allocs: " << writer_allocations
+              << (buffer == built ? "" : " (text differs)")
+              << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::cout << "sizeof(json): " << sizeof(json) << std::endl;
+    bench_build(100000);
+    bench_writer(100000);
+
+    if (argc < 2)
+    {
+        bench_memory("widget", default_corpus);
+        bench_memory("menu", menu_corpus);
+        bench_memory("web-app", web_app_corpus);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        bench_memory(argv[i], read_file(argv[i]));
+    }
+
+    return 0;
+}
@@ -60,7 +60,7 @@ int main()
     std::cout << "menu id: " << m["menu"]["id"].get_string() << std::endl;
     std::cout << "menu value: " << m["menu"]["value"].get_string() << std::endl;
     std::cout << "menu popup : " << std::endl;
-    for(auto& item : m["menu"]["popup"]["menuitem"].get_array())
+    for(auto& item : m["menu"]["popup"]["menuitem"])
     {
         std::cout << "  value: " << item["value"].get_string() << std::endl;
         std::cout << "  onclick: " << item["onclick"].get_string() << std::endl;
@@ -159,11 +159,18 @@ int main()
         "taglib-location": "/WEB-INF/tlds/cofax.tld"}}}
     )DDR");
 
-    for(auto& item : d["web-app"]["servlet"].get_array())
+    for(auto& item : d["web-app"]["servlet"])
     {
         std::cout << "  servlet-name: " << item["servlet-name"].get_string() << std::endl;
         std::cout << "  servlet-class: " << item["servlet-class"].get_string() << std::endl;
     }
 
+    std::cout << "---servlet-mapping:---" << std::endl;
+
+    for(auto& [name, pattern] : d["web-app"]["servlet-mapping"].items())
+    {
+        std::cout << "  " << name << ": " << pattern.get_string_view() << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -1,13 +1,54 @@
 #pragma once
 
+#if defined(_MSC_VER) && !defined(_SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING)
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+#endif
+
 #include <istream>
+#include <ostream>
 #include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
 #include <map>
+#include <unordered_set>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cctype>
+#include <charconv>
 #include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <locale>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
 #include <codecvt>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TINYJSON_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 namespace tinyjson
 {
 
@@ -20,7 +61,7 @@ using u32_sstream = std::basic_stringstream<char32_t>;
         if (t1 != t2) \
         { \
             std::ostringstream oss; \
-            oss << "expect type " << t1 << ", but found type " << t2; \
+            oss << "expect type " << static_cast<int>(t1) << ", but found type " << static_cast<int>(t2); \
             throw std::runtime_error(oss.str() ); \
         } \
     }
@@ -67,7 +108,7 @@ inline std::u32string U8ToU32(std::string u8)
     }
 }
 
-enum json_t
+enum json_t : unsigned char
 {
     string = 0,
     number_integer,
@@ -79,552 +120,5584 @@ enum json_t
     invalid
 };
 
-class json;
+namespace detail
+{
+
+// holds the allocator of a json value, empty allocators take no storage
+template <class Alloc, bool = std::is_empty<Alloc>::value && !std::is_final<Alloc>::value>
+class allocator_holder : private Alloc
+{
+public:
+    explicit allocator_holder(const Alloc& alloc) : Alloc(alloc) {}
 
-using json_object = std::map<std::string, json>;
-using json_array = std::vector<json>;
+    const Alloc& stored_allocator() const { return *this; }
+    Alloc& stored_allocator() { return *this; }
+};
 
-class json
+template <class Alloc>
+class allocator_holder<Alloc, false>
 {
+public:
+    explicit allocator_holder(const Alloc& alloc) : _alloc(alloc) {}
+
+    const Alloc& stored_allocator() const { return _alloc; }
+    Alloc& stored_allocator() { return _alloc; }
+
 private:
-    /// the payload
-    void* _value;
-    /// the value type of the json object
-    json_t _type;
+    Alloc _alloc;
+};
 
-public:
-    /// constructors
-    json();
-    json(std::string val);
-    json(std::string& val);
-    json(char val[]);
-    json(double val);
-    json(int val);
-    json(long long val) ;
-    json(bool val);
-    json(json_array& array);
-    json(json_array&& array);
-    json(json_object& obj);
-    json(json_object&& obj);
+// reference counted payload, shared by copies of a json value until one of them is modified
+template <class T>
+struct shared_payload
+{
+    template <class... Args>
+    explicit shared_payload(Args&&... args) : refs(1), value(std::forward<Args>(args)...) {}
 
-    /// destructor
-    ~json();
+    std::atomic<size_t> refs;
+    // hash of the value, 0 until it is computed and again once the value is modified
+    mutable std::atomic<std::uint64_t> hash{0};
+    T value;
+};
 
-    const json_t type() const;
-    const std::string type_name() const;
+//
+// structural hashing, see basic_json::hash
+//
+constexpr std::uint64_t null_seed = 0x6a09e667f3bcc908ULL;
+constexpr std::uint64_t boolean_seed = 0xbb67ae8584caa73bULL;
+constexpr std::uint64_t number_seed = 0x3c6ef372fe94f82bULL;
+constexpr std::uint64_t string_seed = 0xa54ff53a5f1d36f1ULL;
+constexpr std::uint64_t array_seed = 0x510e527fade682d1ULL;
+constexpr std::uint64_t object_seed = 0x9b05688c2b3e6c1fULL;
+
+inline std::uint64_t hash_mix(std::uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
 
-    // copy constructors
-    json(const json& other);
+inline std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t h)
+{
+    return hash_mix(seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
 
-    // copy assignment
-    json& operator= (const json& other);
-    bool operator== (const json& o) const;
-    bool operator!= (const json& o) const;
+inline std::uint64_t hash_number(long long val)
+{
+    return hash_mix(static_cast<std::uint64_t>(val) ^ number_seed);
+}
 
-    const std::string get_string() const;
-    const long long get_integer() const;
-    const double get_double() const;
-    const bool get_bool() const;
-    const json_object get_object() const;
-    const json_array get_array() const;
-    const void* get_null() const;
+// the integer a double holds exactly, if any
+inline bool double_as_integer(double val, long long& integer)
+{
+    if (val >= -9223372036854775808.0 && val < 9223372036854775808.0 &&
+        static_cast<double>(static_cast<long long>(val)) == val)
+    {
+        integer = static_cast<long long>(val);
+        return true;
+    }
+    return false;
+}
 
-    size_t size() const;
-    bool has_member(std::string member_name);
-    void add_member(std::string member_name, json member_value);
-    void add_element(json elem);
+inline std::uint64_t hash_number(double val)
+{
+    // a double holding an integer hashes like that integer, -0.0 like 0
+    long long integer = 0;
+    if (double_as_integer(val, integer))
+    {
+        return hash_number(integer);
+    }
 
-    // operator [] for object value
-    json& operator [](const char * key);
-    // operator [int] for array value
-    json& operator [](int index);
+    std::uint64_t bits = 0x7ff8000000000000ULL;
+    if (val == val)
+    {
+        std::memcpy(&bits, &val, sizeof(bits));
+    }
+    return hash_mix(bits ^ ~number_seed);
+}
 
-    /// Conversion
-    operator const std::string() const;
-    operator const double() const;
-    operator const long long() const;
-    operator const bool() const;
+inline std::uint64_t hash_string(std::string_view s)
+{
+    return hash_combine(string_seed, std::hash<std::string_view>()(s));
+}
+
+//
+// numbers compare by value: an integer equals a double holding exactly that integer
+//
+inline bool numbers_equal(long long a, long long b)
+{
+    return a == b;
+}
 
-    const std::string to_string() const;
+inline bool numbers_equal(double a, double b)
+{
+    return a == b;
+}
+
+inline bool numbers_equal(long long a, double b)
+{
+    long long integer = 0;
+    return double_as_integer(b, integer) && integer == a;
+}
+
+inline bool numbers_equal(double a, long long b)
+{
+    return numbers_equal(b, a);
+}
+
+// a numeric array stored as plain values. The json elements are only built, once,
+// when the array is read through the generic element accessors.
+template <class T, class Array>
+struct packed_array
+{
+    using values_t = std::vector<T, typename std::allocator_traits<
+        typename Array::allocator_type>::template rebind_alloc<T>>;
+    using allocator_type = typename values_t::allocator_type;
+    using array_traits = typename std::allocator_traits<allocator_type>::template rebind_traits<Array>;
+
+    explicit packed_array(values_t&& vals) : values(std::move(vals)) {}
+    packed_array(const packed_array& other, const allocator_type& alloc) : values(other.values, alloc) {}
+
+    ~packed_array()
+    {
+        if (elems != nullptr)
+        {
+            typename array_traits::allocator_type alloc(values.get_allocator());
+            array_traits::destroy(alloc, elems);
+            array_traits::deallocate(alloc, elems, 1);
+        }
+    }
+
+    Array to_elements() const
+    {
+        typename Array::allocator_type alloc(values.get_allocator());
+        Array elems(alloc);
+        elems.reserve(values.size());
+        for (T val : values)
+        {
+            elems.emplace_back(val, typename Array::value_type::allocator_type(alloc));
+        }
+        return elems;
+    }
+
+    const Array& elements() const
+    {
+        std::call_once(once, [this]()
+        {
+            typename array_traits::allocator_type alloc(values.get_allocator());
+            Array* built = array_traits::allocate(alloc, 1);
+            try
+            {
+                array_traits::construct(alloc, built, to_elements());
+            }
+            catch(...)
+            {
+                array_traits::deallocate(alloc, built, 1);
+                throw;
+            }
+            elems = built;
+        });
+        return *elems;
+    }
+
+    values_t values;
+    mutable std::once_flag once;
+    // built on demand, so an array read only through as_span never has them
+    mutable Array* elems = nullptr;
+};
+
+}   // namespace detail
+
+class frozen_json;
+
+//
+// bytes held by a json value and everything below it, as requested from its allocator
+// (allocator bookkeeping excluded). A payload shared by several copies is counted for
+// each copy that is walked.
+//
+struct memory_usage_t
+{
+    size_t total = 0;
+
+    // the value cells, in arrays, map nodes and the value itself
+    size_t values = 0;
+    // payloads and buffers of strings that do not fit in their cell
+    size_t strings = 0;
+    // key objects in map nodes, and key buffers that do not fit in them
+    size_t keys = 0;
+    // array and object payloads, unused array capacity, map node links, and the
+    // json elements built for reading packed arrays
+    size_t containers = 0;
+    // the values of packed numeric arrays
+    size_t packed = 0;
+
+    // the same bytes by the type of the value that owns them, indexed by json_t
+    size_t by_type[json_t::invalid] = {};
+};
+
+//
+// a read-only view of contiguous values, like std::span<const T>
+//
+template <class T>
+class array_span
+{
+public:
+    array_span() = default;
+    array_span(const T* data, size_t size) : _data(data), _size(size) {}
+
+    const T* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+    const T& operator [](size_t index) const { return _data[index]; }
 
 private:
-    const std::string object_to_string() const;
-    const std::string array_to_string() const;
+    const T* _data = nullptr;
+    size_t _size = 0;
 };
 
 //
-// Implementation
+// output_sink: where serialized text goes. Writers append into space the sink hands
+// out, so a string or a caller's buffer receives the text without intermediate copies,
+// while streams and file descriptors are written a page at a time.
 //
-inline json::json() : _value(nullptr), _type(json_t::null) {}
+class output_sink
+{
+public:
+    virtual ~output_sink() = default;
 
-inline  json::json(std::string val)
-    : _value(new std::string(val)), _type(json_t::string) {}
+    void put(char c)
+    {
+        if (_cursor == _end)
+        {
+            grow(1);
+        }
+        *_cursor++ = c;
+    }
 
-inline json::json(std::string& val)
-    : _value(new std::string(val)), _type(json_t::string) {}
+    void write(const char* data, size_t n)
+    {
+        if (n <= static_cast<size_t>(_end - _cursor))
+        {
+            std::memcpy(_cursor, data, n);
+            _cursor += n;
+            return;
+        }
+        write_slow(data, n);
+    }
 
-inline json::json(char val[])
-    : _value(new std::string(val)), _type(json_t::string) {}
+    void write(std::string_view text) { write(text.data(), text.size()); }
 
-inline json::json(double val)
-    : _value(new double(val)), _type(json_t::number_double) {}
+    // lets format write at most n (up to max_grow) bytes in place and return their end
+    template <class Format>
+    void write_in_place(size_t n, Format format)
+    {
+        if (n <= static_cast<size_t>(_end - _cursor))
+        {
+            _cursor = format(_cursor);
+            return;
+        }
+        char text[max_grow];
+        write(text, format(text) - text);
+    }
 
-inline json::json(long long val)
-    : _value(new long long(val)), _type(json_t::number_integer) {}
+    // data that stays valid until the next flush, like the strings of a value being
+    // dumped; sinks that can send long pieces as they are take them without a copy
+    void write_lasting(const char* data, size_t n)
+    {
+        if (_min_reference != 0 && n >= _min_reference)
+        {
+            reference(data, n);
+            return;
+        }
+        write(data, n);
+    }
 
-inline json::json(int val)
-    : _value(new long long(val)), _type(json_t::number_integer) {}
+    // passes on everything written so far
+    virtual void flush() {}
 
-inline json::json(bool val)
-    : _value(new bool(val)), _type(json_t::boolean) {}
+protected:
+    // the most grow is asked for at once
+    static constexpr size_t max_grow = 256;
 
-inline json::json(json_array& array)
-    : _value(new json_array(array)), _type(json_t::array) {}
+    // makes room for at least n more bytes at _cursor
+    virtual void grow(size_t n) = 0;
 
-inline json::json(json_array&& array)
-    : _value(new json_array(array)), _type(json_t::array) {}
+    // takes n >= _min_reference bytes that stay valid until the next flush
+    virtual void reference(const char* data, size_t n) { write(data, n); }
 
-inline json::json(json_object& obj)
-    : _value(new json_object(obj)), _type(json_t::object) {}
+    char* _cursor = nullptr;
+    char* _end = nullptr;
+    // 0 for sinks that take no references
+    size_t _min_reference = 0;
 
-inline json::json(json_object&& obj)
-    : _value(new json_object(obj)), _type(json_t::object) {}
+private:
+    void write_slow(const char* data, size_t n)
+    {
+        while (n > 0)
+        {
+            if (_cursor == _end)
+            {
+                grow(std::min(n, max_grow));
+            }
 
-inline const json_t json::type() const { return _type; }
+            size_t chunk = std::min(n, static_cast<size_t>(_end - _cursor));
+            std::memcpy(_cursor, data, chunk);
+            _cursor += chunk;
+            data += chunk;
+            n -= chunk;
+        }
+    }
+};
 
-inline const std::string json::type_name() const
+//
+// appends to a std::string or std::vector<char>; reusing one buffer across documents
+// keeps its capacity, so serializing allocates nothing once it has grown
+//
+template <class Buffer = std::string>
+class string_sink : public output_sink
 {
-    switch(_type)
+public:
+    explicit string_sink(Buffer& buffer) : _buffer(buffer)
     {
-        case(json_t::string):
-            return "string";
-
-        case(json_t::array):
-            return "array";
+        _cursor = _end = _buffer.data() + _buffer.size();
+    }
 
-        case(json_t::object):
-            return "object";
+    ~string_sink() override { flush(); }
 
-        case(json_t::number_double):
-        case(json_t::number_integer):
-            return "number";
+    // trims the buffer to the text written
+    void flush() override
+    {
+        size_t used = _cursor - _buffer.data();
+        _buffer.resize(used);
+        _cursor = _end = _buffer.data() + used;
+    }
 
-        case(json_t::boolean):
-            return "boolean";
+protected:
+    void grow(size_t n) override
+    {
+        size_t used = _cursor - _buffer.data();
+        _buffer.resize(std::max({_buffer.capacity(), _buffer.size() * 2, used + n, size_t(256)}));
+        _cursor = _buffer.data() + used;
+        _end = _buffer.data() + _buffer.size();
+    }
 
-        case(json_t::null):
-            return "null";
+private:
+    Buffer& _buffer;
+};
 
-        case(json_t::invalid):
-        default:
-            return "invalid";
+//
+// writes into a caller's fixed buffer and throws when it is full
+//
+class buffer_sink : public output_sink
+{
+public:
+    buffer_sink(char* data, size_t size) : _data(data)
+    {
+        _cursor = data;
+        _end = data + size;
     }
-}
+
+    // bytes written
+    size_t size() const { return _cursor - _data; }
+
+protected:
+    void grow(size_t) override { throw std::runtime_error("output buffer is full"); }
+
+private:
+    char* _data;
+};
 
 //
-// copy constructor
+// writes to a std::ostream a page at a time
 //
-inline json::json(const json& other)
+class ostream_sink : public output_sink
 {
-    _type = other._type;
-    switch(_type)
+public:
+    explicit ostream_sink(std::ostream& os) : _os(os)
     {
-        case json_t::string:
-            _value = new std::string(*static_cast<std::string*>(other._value));
-            break;
-        case json_t::object:
-            _value = new json_object(*static_cast<json_object*>(other._value));
-            break;
-        case json_t::number_double:
-            _value = new double(*static_cast<double*>(other._value));
-            break;
-        case json_t::number_integer:
-            _value = new long long(*static_cast<long long*>(other._value));
-            break;
-        case json_t::array:
-            _value = new json_array(*static_cast<json_array*>(other._value));
-            break;
-        case json_t::boolean:
-            _value = new bool(*static_cast<bool*>(other._value));
-            break;
-        case json_t::null:
-            _value = nullptr;
-            break;
-        default:
-            throw std::runtime_error("unexpected json type: " + other.type_name());
+        _cursor = _page;
+        _end = _page + sizeof(_page);
+    }
+
+    ~ostream_sink() override { flush(); }
+
+    void flush() override
+    {
+        _os.write(_page, _cursor - _page);
+        _cursor = _page;
     }
-}
+
+protected:
+    void grow(size_t) override { flush(); }
+
+private:
+    std::ostream& _os;
+    char _page[4096];
+};
 
 //
-// copy assignment
+// writes to a file descriptor or socket a page at a time, throws when writing fails.
+// Long strings are not copied into the page: they are handed to writev as they are,
+// between the pieces of the page around them.
+//
+// A non-blocking fd that cannot take more calls wait_writable, which returns once it
+// can (after polling it, or running other work meanwhile); without one it throws.
 //
-inline json& json::operator= (const json& other)
+class fd_sink : public output_sink
 {
-    _type = other._type;
-    switch(_type)
+public:
+    using wait_function = std::function<void(int fd)>;
+
+    explicit fd_sink(int fd, wait_function wait_writable = nullptr)
+        : _fd(fd), _wait_writable(std::move(wait_writable))
     {
-        case json_t::string:
-            _value = new std::string(*static_cast<std::string*>(other._value));
-            break;
-        case json_t::object:
-            _value = new json_object(*static_cast<json_object*>(other._value));
-            break;
-        case json_t::number_double:
-            _value = new double(*static_cast<double*>(other._value));
-            break;
-        case json_t::number_integer:
-            _value = new long long(*static_cast<long long*>(other._value));
-            break;
-        case json_t::array:
-            _value = new json_array(*static_cast<json_array*>(other._value));
-            break;
-        case json_t::boolean:
-            _value = new bool(*static_cast<bool*>(other._value));
-            break;
-        case json_t::null:
-            _value = nullptr;
-            break;
-        default:
-            throw std::runtime_error("unexpected json type" + other.type_name());
+        _cursor = _piece = _page;
+        _end = _page + sizeof(_page);
+        _min_reference = 1024;
     }
-    return *this;
-}
 
-inline bool json::operator==(const json& o) const
-{
-    switch(_type)
+    ~fd_sink() override
     {
-        case (json_t::array):
-            if (o._type == array)
-            {
-                json_array* a = static_cast<json_array*>(_value);
-                json_array* b = static_cast<json_array*>(o._value);
-                return *a == *b;
-            }
+        try
+        {
+            flush();
+        }
+        catch(...)
+        {
+            // the error is only reported by an explicit flush
+        }
+    }
 
-        case (json_t::object):
-            if (o._type == object)
-            {
-                json_object* a = static_cast<json_object*>(_value);
-                json_object* b = static_cast<json_object*>(o._value);
-                return *a == *b;
-            }
+    void flush() override
+    {
+        end_piece();
+        size_t count = _count;
+        _count = 0;
+        _cursor = _piece = _page;
 
-        case (json_t::null):
-            if (o._type == null)
-            {
-                return true;
-            }
+        send(count);
+    }
 
-        case (json_t::string):
-            if (o._type == string)
-            {
-                const std::string* a = static_cast<std::string*>(_value);
-                const std::string* b = static_cast<std::string*>(o._value);
-                return *a == *b;
-            }
+protected:
+    void grow(size_t) override { flush(); }
 
-        case (json_t::boolean):
-            if (o._type == boolean)
-            {
-                const bool* a = static_cast<bool*>(_value);
-                const bool* b = static_cast<bool*>(o._value);
-                return *a == *b;
-            }
+    void reference(const char* data, size_t n) override
+    {
+        // one segment is kept for the rest of the page
+        if (_count + 2 >= max_segments)
+        {
+            flush();
+        }
+        end_piece();
+        _segments[_count++] = segment{data, n};
+    }
 
-        case (json_t::number_integer):
-            if (o._type == number_integer)
-            {
-                const long long* a = static_cast<long long*>(_value);
-                const long long* b = static_cast<long long*>(o._value);
-                return *a == *b;
-            }
+private:
+    struct segment
+    {
+        const char* data;
+        size_t size;
+    };
+
+    static constexpr size_t max_segments = 64;
+
+    // the page written since the last segment becomes one
+    void end_piece()
+    {
+        if (_cursor != _piece)
+        {
+            _segments[_count++] = segment{_piece, static_cast<size_t>(_cursor - _piece)};
+            _piece = _cursor;
+        }
+    }
+
+    void send(size_t count)
+    {
+        size_t first = 0;
+        while (first < count)
+        {
+#ifdef _WIN32
+            int written = ::_write(_fd, _segments[first].data, static_cast<unsigned int>(_segments[first].size));
+#else
+            iovec vectors[max_segments];
+            for (size_t i = first; i < count; i++)
+            {
+                vectors[i - first].iov_base = const_cast<char*>(_segments[i].data);
+                vectors[i - first].iov_len = _segments[i].size;
+            }
+            ssize_t written = ::writev(_fd, vectors, static_cast<int>(count - first));
+#endif
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if ((errno == EAGAIN || errno == EWOULDBLOCK) && _wait_writable)
+                {
+                    _wait_writable(_fd);
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    throw std::runtime_error("write failed: fd is not writable and there is no wait function");
+                }
+                throw std::runtime_error("write failed: " + std::string(std::strerror(errno)));
+            }
+
+            // drops what was written, which can end within a segment
+            size_t n = static_cast<size_t>(written);
+            while (first < count && n >= _segments[first].size)
+            {
+                n -= _segments[first].size;
+                first++;
+            }
+            if (n > 0)
+            {
+                _segments[first].data += n;
+                _segments[first].size -= n;
+            }
+        }
+    }
+
+    int _fd;
+    wait_function _wait_writable;
+    char* _piece;
+    segment _segments[max_segments];
+    size_t _count = 0;
+    char _page[16384];
+};
+
+//
+// hashes what is written with SHA-256 (FIPS 180-4) instead of keeping it, a page at
+// a time, so a document can be content addressed or signed without building its text
+//
+class sha256_sink : public output_sink
+{
+public:
+    using digest_type = std::array<std::uint8_t, 32>;
+
+    sha256_sink() { reset(); }
+
+    // hashes the whole blocks written so far; the digest is only taken by digest()
+    void flush() override { compress_page(); }
+
+    // the hash of everything written since construction or the last digest
+    digest_type digest()
+    {
+        // padded with 0x80, zeros, and the length in bits
+        const std::uint64_t bits = (_length + static_cast<std::uint64_t>(_cursor - _page)) * 8;
+        put(static_cast<char>(0x80));
+        while ((_cursor - _page) % 64 != 56)
+        {
+            put('\0');
+        }
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            put(static_cast<char>(bits >> shift));
+        }
+        compress_page();
+
+        digest_type result;
+        for (size_t i = 0; i < 32; i++)
+        {
+            result[i] = static_cast<std::uint8_t>(_state[i / 4] >> (24 - 8 * (i % 4)));
+        }
+        reset();
+        return result;
+    }
+
+protected:
+    void grow(size_t) override { compress_page(); }
+
+private:
+    void reset()
+    {
+        static constexpr std::uint32_t initial[8] =
+        {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        std::copy(initial, initial + 8, _state);
+        _length = 0;
+        _cursor = _page;
+        _end = _page + sizeof(_page);
+    }
+
+    // hashes the whole blocks of the page and keeps the rest at its start
+    void compress_page()
+    {
+        const size_t used = _cursor - _page;
+        const size_t blocks = used / 64;
+        for (size_t i = 0; i < blocks; i++)
+        {
+            compress(reinterpret_cast<const std::uint8_t*>(_page) + i * 64);
+        }
+        _length += blocks * 64;
+
+        const size_t rest = used - blocks * 64;
+        std::memmove(_page, _page + blocks * 64, rest);
+        _cursor = _page + rest;
+    }
+
+    static std::uint32_t rotate(std::uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress(const std::uint8_t* block)
+    {
+        static constexpr std::uint32_t k[64] =
+        {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        std::uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+        {
+            w[i] = (std::uint32_t{block[i * 4]} << 24) | (std::uint32_t{block[i * 4 + 1]} << 16) |
+                   (std::uint32_t{block[i * 4 + 2]} << 8) | std::uint32_t{block[i * 4 + 3]};
+        }
+        for (int i = 16; i < 64; i++)
+        {
+            const std::uint32_t s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const std::uint32_t s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        std::uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+        std::uint32_t e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+        for (int i = 0; i < 64; i++)
+        {
+            const std::uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            const std::uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        _state[0] += a;
+        _state[1] += b;
+        _state[2] += c;
+        _state[3] += d;
+        _state[4] += e;
+        _state[5] += f;
+        _state[6] += g;
+        _state[7] += h;
+    }
+
+    std::uint32_t _state[8];
+    std::uint64_t _length;
+    char _page[4096];
+};
+
+//
+// how dump() writes text. Compact text has no whitespace at all; pretty text puts
+// every member and element on a line of its own, indented by indent indent_chars
+// per level, and a space after each colon.
+//
+struct dump_options
+{
+    bool pretty = false;
+    unsigned indent = 4;
+    char indent_char = ' ';
+
+    // non-ASCII characters are written as \u escapes, with surrogate pairs above U+FFFF
+    bool ascii_only = false;
+};
+
+namespace detail
+{
+
+//
+// text of scalar tokens, written without temporaries
+//
+// room for the longest text format_integer writes, -9223372036854775808 (20)
+constexpr size_t max_integer_chars = 20;
+
+// "00", "01", ... "99": two digits per division
+inline constexpr char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+inline int count_digits(unsigned long long val)
+{
+    int digits = 1;
+    for (;;)
+    {
+        if (val < 10) return digits;
+        if (val < 100) return digits + 1;
+        if (val < 1000) return digits + 2;
+        if (val < 10000) return digits + 3;
+        val /= 10000;
+        digits += 4;
+    }
+}
+
+//
+// writes the decimal text of val and returns its end. The length is known up front,
+// so the digits are written back to front, two at a time, straight into their place.
+//
+inline char* format_integer(char* out, unsigned long long val)
+{
+    char* end = out + count_digits(val);
+    char* p = end;
+    while (val >= 100)
+    {
+        const size_t pair = static_cast<size_t>(val % 100) * 2;
+        val /= 100;
+        p -= 2;
+        std::memcpy(p, digit_pairs + pair, 2);
+    }
+    if (val >= 10)
+    {
+        std::memcpy(p - 2, digit_pairs + val * 2, 2);
+    }
+    else
+    {
+        p[-1] = static_cast<char>('0' + val);
+    }
+    return end;
+}
+
+inline char* format_integer(char* out, long long val)
+{
+    // negated as unsigned, so the lowest value has a magnitude too
+    unsigned long long magnitude = static_cast<unsigned long long>(val);
+    if (val < 0)
+    {
+        *out++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    return format_integer(out, magnitude);
+}
+
+inline void write_integer(output_sink& out, long long val)
+{
+    out.write_in_place(max_integer_chars, [val](char* text) { return format_integer(text, val); });
+}
+
+//
+// shortest round-trip text of doubles: Grisu3 (Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers", 2010) finds the fewest digits that
+// read back as the same double, and the closest of them, for all but about 0.5% of
+// values, which go through printf. The layout follows ECMAScript's Number::toString.
+//
+namespace grisu
+{
+
+struct diyfp
+{
+    std::uint64_t f;
+    int e;
+
+    static diyfp sub(diyfp x, diyfp y) { return diyfp{x.f - y.f, x.e}; }
+
+    // the upper 64 bits of the product, rounded
+    static diyfp mul(diyfp x, diyfp y)
+    {
+        const std::uint64_t u_lo = x.f & 0xFFFFFFFFu;
+        const std::uint64_t u_hi = x.f >> 32;
+        const std::uint64_t v_lo = y.f & 0xFFFFFFFFu;
+        const std::uint64_t v_hi = y.f >> 32;
+
+        const std::uint64_t p0 = u_lo * v_lo;
+        const std::uint64_t p1 = u_lo * v_hi;
+        const std::uint64_t p2 = u_hi * v_lo;
+        const std::uint64_t p3 = u_hi * v_hi;
+
+        std::uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+        q += std::uint64_t{1} << 31;
+
+        return diyfp{p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), x.e + y.e + 64};
+    }
+
+    static diyfp normalize(diyfp x)
+    {
+        while ((x.f >> 63) == 0)
+        {
+            x.f <<= 1;
+            x.e--;
+        }
+        return x;
+    }
+
+    static diyfp normalize_to(diyfp x, int e) { return diyfp{x.f << (x.e - e), e}; }
+};
+
+// value and the halfway points to its neighbours, all with the exponent of the upper one
+struct boundaries
+{
+    diyfp w;
+    diyfp minus;
+    diyfp plus;
+};
+
+inline boundaries compute_boundaries(double value)
+{
+    constexpr int bias = 1023 + 52;
+    constexpr std::uint64_t hidden_bit = std::uint64_t{1} << 52;
+
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const std::uint64_t e = bits >> 52;
+    const std::uint64_t f = bits & (hidden_bit - 1);
+
+    const diyfp v = (e == 0) ? diyfp{f, 1 - bias} : diyfp{f + hidden_bit, static_cast<int>(e) - bias};
+
+    // at a power of two the gap to the lower neighbour is half as wide
+    const bool lower_closer = (f == 0 && e > 1);
+    const diyfp m_plus{2 * v.f + 1, v.e - 1};
+    const diyfp m_minus = lower_closer ? diyfp{4 * v.f - 1, v.e - 2} : diyfp{2 * v.f - 1, v.e - 1};
+
+    const diyfp w_plus = diyfp::normalize(m_plus);
+    return boundaries{diyfp::normalize(v), diyfp::normalize_to(m_minus, w_plus.e), w_plus};
+}
+
+struct cached_power
+{
+    std::uint64_t f;
+    int e;
+    int k;
+};
+
+// 10^k for k = -300, -292, ..., 324, normalized to 64 bits
+inline cached_power get_cached_power(int e)
+{
+    static constexpr cached_power powers[] =
+    {
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL, -980, -276 },
+    { 0xD3515C2831559A83ULL, -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL, -927, -260 },
+    { 0xEA9C227723EE8BCBULL, -901, -252 },
+    { 0xAECC49914078536DULL, -874, -244 },
+    { 0x823C12795DB6CE57ULL, -847, -236 },
+    { 0xC21094364DFB5637ULL, -821, -228 },
+    { 0x9096EA6F3848984FULL, -794, -220 },
+    { 0xD77485CB25823AC7ULL, -768, -212 },
+    { 0xA086CFCD97BF97F4ULL, -741, -204 },
+    { 0xEF340A98172AACE5ULL, -715, -196 },
+    { 0xB23867FB2A35B28EULL, -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL, -661, -180 },
+    { 0xC5DD44271AD3CDBAULL, -635, -172 },
+    { 0x936B9FCEBB25C996ULL, -608, -164 },
+    { 0xDBAC6C247D62A584ULL, -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL, -555, -148 },
+    { 0xF3E2F893DEC3F126ULL, -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL, -502, -132 },
+    { 0x87625F056C7C4A8BULL, -475, -124 },
+    { 0xC9BCFF6034C13053ULL, -449, -116 },
+    { 0x964E858C91BA2655ULL, -422, -108 },
+    { 0xDFF9772470297EBDULL, -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL, -369, -92 },
+    { 0xF8A95FCF88747D94ULL, -343, -84 },
+    { 0xB94470938FA89BCFULL, -316, -76 },
+    { 0x8A08F0F8BF0F156BULL, -289, -68 },
+    { 0xCDB02555653131B6ULL, -263, -60 },
+    { 0x993FE2C6D07B7FACULL, -236, -52 },
+    { 0xE45C10C42A2B3B06ULL, -210, -44 },
+    { 0xAA242499697392D3ULL, -183, -36 },
+    { 0xFD87B5F28300CA0EULL, -157, -28 },
+    { 0xBCE5086492111AEBULL, -130, -20 },
+    { 0x8CBCCC096F5088CCULL, -103, -12 },
+    { 0xD1B71758E219652CULL, -77, -4 },
+    { 0x9C40000000000000ULL, -50, 4 },
+    { 0xE8D4A51000000000ULL, -24, 12 },
+    { 0xAD78EBC5AC620000ULL, 3, 20 },
+    { 0x813F3978F8940984ULL, 30, 28 },
+    { 0xC097CE7BC90715B3ULL, 56, 36 },
+    { 0x8F7E32CE7BEA5C70ULL, 83, 44 },
+    { 0xD5D238A4ABE98068ULL, 109, 52 },
+    { 0x9F4F2726179A2245ULL, 136, 60 },
+    { 0xED63A231D4C4FB27ULL, 162, 68 },
+    { 0xB0DE65388CC8ADA8ULL, 189, 76 },
+    { 0x83C7088E1AAB65DBULL, 216, 84 },
+    { 0xC45D1DF942711D9AULL, 242, 92 },
+    { 0x924D692CA61BE758ULL, 269, 100 },
+    { 0xDA01EE641A708DEAULL, 295, 108 },
+    { 0xA26DA3999AEF774AULL, 322, 116 },
+    { 0xF209787BB47D6B85ULL, 348, 124 },
+    { 0xB454E4A179DD1877ULL, 375, 132 },
+    { 0x865B86925B9BC5C2ULL, 402, 140 },
+    { 0xC83553C5C8965D3DULL, 428, 148 },
+    { 0x952AB45CFA97A0B3ULL, 455, 156 },
+    { 0xDE469FBD99A05FE3ULL, 481, 164 },
+    { 0xA59BC234DB398C25ULL, 508, 172 },
+    { 0xF6C69A72A3989F5CULL, 534, 180 },
+    { 0xB7DCBF5354E9BECEULL, 561, 188 },
+    { 0x88FCF317F22241E2ULL, 588, 196 },
+    { 0xCC20CE9BD35C78A5ULL, 614, 204 },
+    { 0x98165AF37B2153DFULL, 641, 212 },
+    { 0xE2A0B5DC971F303AULL, 667, 220 },
+    { 0xA8D9D1535CE3B396ULL, 694, 228 },
+    { 0xFB9B7CD9A4A7443CULL, 720, 236 },
+    { 0xBB764C4CA7A44410ULL, 747, 244 },
+    { 0x8BAB8EEFB6409C1AULL, 774, 252 },
+    { 0xD01FEF10A657842CULL, 800, 260 },
+    { 0x9B10A4E5E9913129ULL, 827, 268 },
+    { 0xE7109BFBA19C0C9DULL, 853, 276 },
+    { 0xAC2820D9623BF429ULL, 880, 284 },
+    { 0x80444B5E7AA7CF85ULL, 907, 292 },
+    { 0xBF21E44003ACDD2DULL, 933, 300 },
+    { 0x8E679C2F5E44FF8FULL, 960, 308 },
+    { 0xD433179D9C8CB841ULL, 986, 316 },
+    { 0x9E19DB92B4E31BA9ULL, 1013, 324 },
+    };
+
+    // the digits are generated with an exponent between alpha and gamma
+    constexpr int alpha = -60;
+    constexpr int min_k = -300;
+    constexpr int step = 8;
+
+    // k = ceil((alpha - e - 1) * log10(2)), without floating point
+    const int f = alpha - e - 1;
+    const int k = (f * 78913) / (1 << 18) + static_cast<int>(f > 0);
+    return powers[(-min_k + k + (step - 1)) / step];
+}
+
+// the number of decimal digits of n, and the power of ten of the first one
+inline int find_largest_pow10(std::uint32_t n, std::uint32_t& pow10)
+{
+    std::uint32_t p = 1000000000;
+    int digits = 10;
+    while (digits > 1 && n < p)
+    {
+        p /= 10;
+        digits--;
+    }
+    pow10 = p;
+    return digits;
+}
+
+//
+// moves the last digit towards w while staying within the boundaries. The scaled
+// values are only known to within unit; false when that leaves the closest digits or
+// their being within the boundaries in doubt.
+//
+inline bool round_weed(char* buf, int len, std::uint64_t dist, std::uint64_t unsafe_interval,
+                       std::uint64_t rest, std::uint64_t ten_k, std::uint64_t unit)
+{
+    const std::uint64_t small_dist = dist - unit;
+    const std::uint64_t big_dist = dist + unit;
+
+    while (rest < small_dist && unsafe_interval - rest >= ten_k &&
+           (rest + ten_k < small_dist || small_dist - rest >= rest + ten_k - small_dist))
+    {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+
+    // one more step could be closer to w as far as unit lets us tell
+    if (rest < big_dist && unsafe_interval - rest >= ten_k &&
+        (rest + ten_k < big_dist || big_dist - rest > rest + ten_k - big_dist))
+    {
+        return false;
+    }
+
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+// generates digits from the upper boundary down until they are within the interval
+inline bool digit_gen(char* buf, int& len, int& decimal_exponent, diyfp m_minus, diyfp w, diyfp m_plus)
+{
+    // widened by unit, so a digit inside the interval might only be inside it by the error
+    std::uint64_t unit = 1;
+    const diyfp too_low{m_minus.f - unit, m_minus.e};
+    const diyfp too_high{m_plus.f + unit, m_plus.e};
+    std::uint64_t unsafe_interval = diyfp::sub(too_high, too_low).f;
+    const std::uint64_t dist = diyfp::sub(too_high, w).f;
+
+    const diyfp one{std::uint64_t{1} << -w.e, w.e};
+
+    std::uint32_t p1 = static_cast<std::uint32_t>(too_high.f >> -one.e);
+    std::uint64_t p2 = too_high.f & (one.f - 1);
+
+    // integral digits
+    std::uint32_t pow10 = 0;
+    int n = find_largest_pow10(p1, pow10);
+    while (n > 0)
+    {
+        const std::uint32_t d = p1 / pow10;
+        p1 %= pow10;
+        buf[len++] = static_cast<char>('0' + d);
+        n--;
+
+        const std::uint64_t rest = (std::uint64_t{p1} << -one.e) + p2;
+        if (rest < unsafe_interval)
+        {
+            decimal_exponent += n;
+            return round_weed(buf, len, dist, unsafe_interval, rest, std::uint64_t{pow10} << -one.e, unit);
+        }
+        pow10 /= 10;
+    }
+
+    // fractional digits
+    int m = 0;
+    for (;;)
+    {
+        p2 *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        buf[len++] = static_cast<char>('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        m++;
+        if (p2 < unsafe_interval)
+        {
+            break;
+        }
+    }
+
+    decimal_exponent -= m;
+    return round_weed(buf, len, dist * unit, unsafe_interval, p2, one.f, unit);
+}
+
+// Grisu3: the shortest digits of a finite value > 0, value = digits * 10^decimal_exponent,
+// and the closest of them; false for the few values it cannot decide
+inline bool grisu3(char* buf, int& len, int& decimal_exponent, double value)
+{
+    const boundaries b = compute_boundaries(value);
+    const cached_power cached = get_cached_power(b.plus.e);
+    const diyfp c{cached.f, cached.e};
+
+    len = 0;
+    decimal_exponent = -cached.k;
+    return digit_gen(buf, len, decimal_exponent, diyfp::mul(b.minus, c), diyfp::mul(b.w, c), diyfp::mul(b.plus, c));
+}
+
+// the same through printf, which rounds correctly: the fewest digits that read back
+inline void shortest_digits_slow(char* buf, int& len, int& decimal_exponent, double value)
+{
+    char text[40];
+    for (int precision = 0; precision < 17; precision++)
+    {
+        std::snprintf(text, sizeof(text), "%.*e", precision, value);
+        if (std::strtod(text, nullptr) == value)
+        {
+            break;
+        }
+    }
+
+    // d.ddde+x, with the decimal point of the current locale
+    const char* p = text;
+    len = 0;
+    for (; *p != 'e'; p++)
+    {
+        if (*p >= '0' && *p <= '9')
+        {
+            buf[len++] = *p;
+        }
+    }
+    decimal_exponent = std::atoi(p + 1) - (len - 1);
+}
+
+inline void shortest_digits(char* buf, int& len, int& decimal_exponent, double value)
+{
+    if (!grisu3(buf, len, decimal_exponent, value))
+    {
+        shortest_digits_slow(buf, len, decimal_exponent, value);
+    }
+}
+
+}   // namespace grisu
+
+// room for the longest text format_double writes, -0.0000012345678901234567 (25)
+constexpr size_t max_double_chars = 32;
+
+//
+// writes a finite value as ECMAScript's Number::toString does: the shortest digits,
+// in plain notation for decimal exponents from -7 to 20 and as d.ddde+x otherwise.
+// Zero is "0", without a sign.
+//
+inline char* format_double(char* out, double value)
+{
+    if (value == 0)
+    {
+        *out++ = '0';
+        return out;
+    }
+    if (value < 0)
+    {
+        *out++ = '-';
+        value = -value;
+    }
+
+    char digits[18];
+    int len = 0;
+    int decimal_exponent = 0;
+    grisu::shortest_digits(digits, len, decimal_exponent, value);
+
+    // the decimal point goes after the first n digits
+    const int n = len + decimal_exponent;
+
+    if (len <= n && n <= 21)
+    {
+        std::memcpy(out, digits, len);
+        std::memset(out + len, '0', n - len);
+        return out + n;
+    }
+    if (0 < n && n <= 21)
+    {
+        std::memcpy(out, digits, n);
+        out[n] = '.';
+        std::memcpy(out + n + 1, digits + n, len - n);
+        return out + len + 1;
+    }
+    if (-6 < n && n <= 0)
+    {
+        *out++ = '0';
+        *out++ = '.';
+        std::memset(out, '0', -n);
+        std::memcpy(out - n, digits, len);
+        return out - n + len;
+    }
+
+    *out++ = digits[0];
+    if (len > 1)
+    {
+        *out++ = '.';
+        std::memcpy(out, digits + 1, len - 1);
+        out += len - 1;
+    }
+    *out++ = 'e';
+    *out++ = (n - 1 < 0) ? '-' : '+';
+    return std::to_chars(out, out + 3, std::abs(n - 1)).ptr;
+}
+
+// room for the longest text format_json_double writes
+constexpr size_t max_json_double_chars = max_double_chars + 2;
+
+// the shortest text that reads back as the same double. It always has a '.' or an
+// exponent so it reads back as a double, and NaN and infinities, which JSON cannot
+// express, are written as null.
+inline char* format_json_double(char* out, double val)
+{
+    if (!(val - val == 0))
+    {
+        std::memcpy(out, "null", 4);
+        return out + 4;
+    }
+
+    if (val == 0)
+    {
+        const std::string_view zero = std::signbit(val) ? "-0.0" : "0.0";
+        std::memcpy(out, zero.data(), zero.size());
+        return out + zero.size();
+    }
+
+    char* end = format_double(out, val);
+    if (std::find_if(out, end, [](char c) { return c == '.' || c == 'e'; }) == end)
+    {
+        *end++ = '.';
+        *end++ = '0';
+    }
+    return end;
+}
+
+inline void write_double(output_sink& out, double val)
+{
+    out.write_in_place(max_json_double_chars, [val](char* text) { return format_json_double(text, val); });
+}
+
+#ifdef TINYJSON_SSE2
+inline int lowest_set_bit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// the first byte of [p, end) that cannot be written as it is between quotes
+inline const char* find_escape(const char* p, const char* end, bool ascii_only)
+{
+#ifdef TINYJSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    const int non_ascii = ascii_only ? 0xFFFF : 0;
+
+    for (; end - p >= 16; p += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+        // control characters are the bytes max(byte, 0x1F) leaves at 0x1F
+        const __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+
+        // the sign bits are the bytes of multibyte characters
+        const int mask = _mm_movemask_epi8(special) | (_mm_movemask_epi8(chunk) & non_ascii);
+        if (mask != 0)
+        {
+            return p + lowest_set_bit(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+
+    // 1 for what is always escaped, 2 for what ASCII only mode escapes too
+    static constexpr auto escape_classes = []() {
+        std::array<unsigned char, 256> classes{};
+        for (int c = 0; c < 0x20; c++)
+        {
+            classes[c] = 1;
+        }
+        classes['"'] = classes['\\'] = 1;
+        for (int c = 0x80; c < 0x100; c++)
+        {
+            classes[c] = 2;
+        }
+        return classes;
+    }();
+
+    const unsigned char escaped = ascii_only ? 3 : 1;
+    while (p < end && (escape_classes[static_cast<unsigned char>(*p)] & escaped) == 0)
+    {
+        p++;
+    }
+    return p;
+}
+
+inline char* format_unicode_escape(char* out, unsigned unit)
+{
+    static constexpr char hex[] = "0123456789abcdef";
+    out[0] = '\\';
+    out[1] = 'u';
+    out[2] = hex[(unit >> 12) & 0xF];
+    out[3] = hex[(unit >> 8) & 0xF];
+    out[4] = hex[(unit >> 4) & 0xF];
+    out[5] = hex[unit & 0xF];
+    return out + 6;
+}
+
+// decodes the UTF-8 sequence at p and moves past it; a malformed one is a U+FFFD one byte long
+inline char32_t decode_utf8(const char*& p, const char* end)
+{
+    static constexpr char32_t smallest[] = {0, 0, 0x80, 0x800, 0x10000};
+
+    const unsigned char lead = static_cast<unsigned char>(*p);
+    const int length = (lead >= 0xF0) ? 4 : (lead >= 0xE0) ? 3 : (lead >= 0xC0) ? 2 : 0;
+    if (length == 0 || end - p < length)
+    {
+        p++;
+        return 0xFFFD;
+    }
+
+    char32_t c = lead & (0x3F >> (length - 1));
+    for (int i = 1; i < length; i++)
+    {
+        const unsigned char next = static_cast<unsigned char>(p[i]);
+        if ((next & 0xC0) != 0x80)
+        {
+            p++;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (next & 0x3F);
+    }
+
+    // overlong forms, surrogates and values past U+10FFFF are not characters
+    if (c < smallest[length] || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000))
+    {
+        p++;
+        return 0xFFFD;
+    }
+    p += length;
+    return c;
+}
+
+// room for the longest escape, a surrogate pair
+constexpr size_t max_escape_chars = 12;
+
+// the escape of the character at p, which find_escape stopped at; moves p past it
+inline char* format_escape(char* out, const char*& p, const char* end)
+{
+    const unsigned char c = static_cast<unsigned char>(*p);
+    char short_form = 0;
+    switch (c)
+    {
+        case '"': short_form = '"'; break;
+        case '\\': short_form = '\\'; break;
+        case '\b': short_form = 'b'; break;
+        case '\f': short_form = 'f'; break;
+        case '\n': short_form = 'n'; break;
+        case '\r': short_form = 'r'; break;
+        case '\t': short_form = 't'; break;
+        default: break;
+    }
+    if (short_form != 0)
+    {
+        p++;
+        out[0] = '\\';
+        out[1] = short_form;
+        return out + 2;
+    }
+
+    if (c < 0x80)
+    {
+        p++;
+        return format_unicode_escape(out, c);
+    }
+
+    char32_t code_point = decode_utf8(p, end);
+    if (code_point >= 0x10000)
+    {
+        code_point -= 0x10000;
+        out = format_unicode_escape(out, 0xD800 + (code_point >> 10));
+        return format_unicode_escape(out, 0xDC00 + (code_point & 0x3FF));
+    }
+    return format_unicode_escape(out, code_point);
+}
+
+inline const char* write_escape(output_sink& out, const char* p, const char* end)
+{
+    out.write_in_place(max_escape_chars, [&p, end](char* text) { return format_escape(text, p, end); });
+    return p;
+}
+
+//
+// quotes s and escapes what JSON requires: quotes, backslashes and control characters.
+// Runs without any of them are found 16 bytes at a time and copied in one piece, or
+// passed by reference when s is lasting, valid until the next flush.
+//
+inline void write_string(output_sink& out, std::string_view s, bool ascii_only = false, bool lasting = false)
+{
+    const char* p = s.data();
+    const char* end = p + s.size();
+    const char* special = find_escape(p, end, ascii_only);
+
+    // most strings are short and have nothing to escape; they go out in one piece
+    if (special == end && s.size() <= 64)
+    {
+        out.write_in_place(s.size() + 2, [s](char* text) {
+            text[0] = '"';
+            std::memcpy(text + 1, s.data(), s.size());
+            text[s.size() + 1] = '"';
+            return text + s.size() + 2;
+        });
+        return;
+    }
+
+    out.put('"');
+    for (;;)
+    {
+        lasting ? out.write_lasting(p, special - p) : out.write(p, special - p);
+        if (special == end)
+        {
+            break;
+        }
+        p = write_escape(out, special, end);
+        special = find_escape(p, end, ascii_only);
+    }
+    out.put('"');
+}
+
+// starts a line of pretty text at the indentation of depth; nothing in compact text
+inline void write_line_break(output_sink& out, const dump_options& options, size_t depth)
+{
+    if (!options.pretty)
+    {
+        return;
+    }
+
+    out.put('\n');
+    for (size_t n = options.indent * depth; n > 0;)
+    {
+        const size_t chunk = std::min<size_t>(n, 64);
+        out.write_in_place(chunk, [&options, chunk](char* text) {
+            std::memset(text, options.indent_char, chunk);
+            return text + chunk;
+        });
+        n -= chunk;
+    }
+}
+
+//
+// lengths of the text the functions above write, for sizing output up front
+//
+inline size_t integer_text_size(long long val)
+{
+    return (val < 0) + count_digits(val < 0 ? 0 - static_cast<unsigned long long>(val) : val);
+}
+
+inline size_t double_text_size(double val)
+{
+    char text[max_json_double_chars];
+    return format_json_double(text, val) - text;
+}
+
+inline size_t string_text_size(std::string_view s, bool ascii_only)
+{
+    const char* p = s.data();
+    const char* end = p + s.size();
+    size_t size = 2;
+    for (;;)
+    {
+        const char* special = find_escape(p, end, ascii_only);
+        size += special - p;
+        if (special == end)
+        {
+            return size;
+        }
+        char text[max_escape_chars];
+        p = special;
+        size += format_escape(text, p, end) - text;
+    }
+}
+
+inline size_t line_break_size(const dump_options& options, size_t depth)
+{
+    return options.pretty ? 1 + options.indent * depth : 0;
+}
+
+//
+// RFC 8785 canonical text
+//
+
+// numbers as ES6 writes doubles; NaN and infinities have no JSON form
+inline void write_canonical_number(output_sink& out, double val)
+{
+    if (!(val - val == 0))
+    {
+        throw std::runtime_error("NaN and infinity have no canonical form");
+    }
+    out.write_in_place(max_double_chars, [val](char* text) { return format_double(text, val); });
+}
+
+//
+// orders strings by their UTF-16 code units, as RFC 8785 sorts keys. That is their
+// UTF-8 byte order except that characters past U+FFFF, surrogate pairs in UTF-16,
+// come before U+E000 to U+FFFF.
+//
+inline bool utf16_less(std::string_view a, std::string_view b)
+{
+    const auto differ = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+    if (differ.second == b.end())
+    {
+        return false;
+    }
+    if (differ.first == a.end())
+    {
+        return true;
+    }
+
+    // the characters that differ start at the same place in both
+    size_t at = differ.first - a.begin();
+    while (at > 0 && (static_cast<unsigned char>(a[at]) & 0xC0) == 0x80)
+    {
+        at--;
+    }
+
+    auto first_unit = [at](std::string_view s, char32_t& c) -> char32_t {
+        const char* p = s.data() + at;
+        c = (static_cast<unsigned char>(*p) < 0x80) ? static_cast<char32_t>(*p) : decode_utf8(p, s.data() + s.size());
+        return (c >= 0x10000) ? 0xD800 + ((c - 0x10000) >> 10) : c;
+    };
+    char32_t ca = 0;
+    char32_t cb = 0;
+    const char32_t unit_a = first_unit(a, ca);
+    const char32_t unit_b = first_unit(b, cb);
+    return (unit_a != unit_b) ? unit_a < unit_b : ca < cb;
+}
+
+// byte order is UTF-16 order unless a key has a character from U+E000 up
+inline bool has_utf16_order(std::string_view key)
+{
+    return std::find_if(key.begin(), key.end(), [](char c) { return static_cast<unsigned char>(c) >= 0xEE; }) == key.end();
+}
+
+}   // namespace detail
+
+//
+// writes JSON token by token into a sink, for output that never needs to exist as a
+// json value:
+//
+//     json_writer writer(out);
+//     writer.begin_object().key("id").value(42).key("tags").begin_array().value("a").end_array().end_object();
+//
+// Nothing is allocated per token. Unless NDEBUG is defined, tokens out of place (a
+// value where a key belongs, an end that does not match its begin, a second top level
+// value) throw.
+//
+class json_writer
+{
+public:
+    explicit json_writer(output_sink& out, const dump_options& options = dump_options())
+        : _out(out), _options(options)
+    {
+        _levels.reserve(32);
+    }
+
+    json_writer& begin_object()
+    {
+        begin_value();
+        _out.put('{');
+        _levels.push_back(in_object);
+        return *this;
+    }
+
+    json_writer& end_object()
+    {
+        end_container(in_object, '}');
+        return *this;
+    }
+
+    json_writer& begin_array()
+    {
+        begin_value();
+        _out.put('[');
+        _levels.push_back(0);
+        return *this;
+    }
+
+    json_writer& end_array()
+    {
+        end_container(0, ']');
+        return *this;
+    }
+
+    json_writer& key(std::string_view name)
+    {
+        check(!_levels.empty() && (_levels.back() & (in_object | after_key)) == in_object,
+              "a key belongs directly in an object, before its value");
+        separate();
+        detail::write_string(_out, name, _options.ascii_only);
+        _options.pretty ? _out.write(": ", 2) : _out.put(':');
+        _levels.back() |= after_key;
+        return *this;
+    }
+
+    json_writer& value(long long val)
+    {
+        begin_value();
+        detail::write_integer(_out, val);
+        return *this;
+    }
+
+    json_writer& value(unsigned long long val)
+    {
+        begin_value();
+        _out.write_in_place(detail::max_integer_chars, [val](char* text) { return detail::format_integer(text, val); });
+        return *this;
+    }
+
+    json_writer& value(double val)
+    {
+        begin_value();
+        detail::write_double(_out, val);
+        return *this;
+    }
+
+    json_writer& value(std::string_view val)
+    {
+        begin_value();
+        detail::write_string(_out, val, _options.ascii_only);
+        return *this;
+    }
+
+    json_writer& value(const char* val) { return value(std::string_view(val)); }
+
+    json_writer& value(bool val)
+    {
+        begin_value();
+        _out.write(val ? std::string_view("true") : std::string_view("false"));
+        return *this;
+    }
+
+    // the other integer types, which would be ambiguous between the overloads above
+    template <class T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    json_writer& value(T val)
+    {
+        if constexpr (std::is_signed<T>::value)
+        {
+            return value(static_cast<long long>(val));
+        }
+        else
+        {
+            return value(static_cast<unsigned long long>(val));
+        }
+    }
+
+    json_writer& null()
+    {
+        begin_value();
+        _out.write("null", 4);
+        return *this;
+    }
+
+    // whether a whole top level value has been written
+    bool complete() const { return _written && _levels.empty(); }
+
+    void flush() { _out.flush(); }
+
+private:
+    // what is known about each open object or array
+    enum : unsigned char
+    {
+        in_object = 1,
+        has_elements = 2,
+        after_key = 4
+    };
+
+    void check(bool ok, const char* message) const
+    {
+#ifndef NDEBUG
+        if (!ok)
+        {
+            throw std::runtime_error(std::string("json writer: ") + message);
+        }
+#else
+        (void)ok;
+        (void)message;
+#endif
+    }
+
+    // the comma and line break before a key or an element of an array
+    void separate()
+    {
+        unsigned char& level = _levels.back();
+        if (level & has_elements)
+        {
+            _out.put(',');
+        }
+        level |= has_elements;
+        detail::write_line_break(_out, _options, _levels.size());
+    }
+
+    void begin_value()
+    {
+        if (_levels.empty())
+        {
+            check(!_written, "a document has a single top level value");
+            _written = true;
+            return;
+        }
+
+        unsigned char& level = _levels.back();
+        if (level & in_object)
+        {
+            check((level & after_key) != 0, "a value in an object needs its key first");
+            level &= static_cast<unsigned char>(~after_key);
+            return;
+        }
+        separate();
+    }
+
+    void end_container(unsigned char kind, char bracket)
+    {
+        check(!_levels.empty() && (_levels.back() & in_object) == kind && (_levels.back() & after_key) == 0,
+              kind == in_object ? "end_object does not close an object, or a key has no value"
+                                : "end_array does not close an array");
+        const bool had_elements = (_levels.back() & has_elements) != 0;
+        _levels.pop_back();
+        if (had_elements)
+        {
+            detail::write_line_break(_out, _options, _levels.size());
+        }
+        _out.put(bracket);
+    }
+
+    output_sink& _out;
+    dump_options _options;
+    std::vector<unsigned char> _levels;
+    bool _written = false;
+};
+
+//
+// basic_json stores strings, arrays and objects through Allocator (rebound as needed).
+// The allocator's pointer type must be a raw pointer.
+//
+// A value is a 16 byte cell (plus the allocator when it is stateful): scalars and
+// strings of up to 14 bytes live inline, longer strings, arrays and objects are
+// a pointer to their heap payload.
+//
+// Arrays of only integers or only doubles can be packed: the values are stored without
+// json elements and read in place through as_span<long long>() or as_span<double>().
+// Reading a packed array through the generic accessors builds its json elements once;
+// any modification other than appending a number of the same kind unpacks it.
+// Iterating keeps it packed, also through a non-const value, so the elements it gives
+// are for reading only: modify them through the non-const operator[], which unpacks.
+//
+// Heap payloads are shared between copies and cloned (one level deep) by the first
+// mutation through add_member, add_element, emplace_member, emplace_element, reserve
+// or a non-const operator[], so copying a
+// json is O(1). Copies of a value may be read and copied from several threads; a
+// reference returned by a non-const accessor must not be used to modify a value
+// after it, or a value holding it, has been copied or hashed.
+//
+template <class Allocator = std::allocator<char>>
+class basic_json
+    : private detail::allocator_holder<typename std::allocator_traits<Allocator>::template rebind_alloc<char>>
+{
+private:
+    template <class T>
+    using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+    using allocator_base = detail::allocator_holder<rebind_alloc<char>>;
+
+public:
+    using allocator_type = rebind_alloc<char>;
+    using string_t = std::basic_string<char, std::char_traits<char>, allocator_type>;
+    using array_t = std::vector<basic_json, rebind_alloc<basic_json>>;
+    // std::less<> lets members be looked up by std::string_view without a temporary key
+    using object_t = std::map<string_t, basic_json, std::less<>,
+                              rebind_alloc<std::pair<const string_t, basic_json>>>;
+    using iterator = typename array_t::iterator;
+    using const_iterator = typename array_t::const_iterator;
+    // storage of packed numeric arrays
+    using integer_array_t = std::vector<long long, rebind_alloc<long long>>;
+    using double_array_t = std::vector<double, rebind_alloc<double>>;
+
+    // string values up to this length live in the value cell without any allocation.
+    // Member keys are string_t, which keeps short keys in the map node the same way.
+    static constexpr size_t short_string_capacity = 14;
+
+private:
+    static constexpr unsigned char long_string = 0xFF;
+    // _length of an array tells its storage
+    static constexpr unsigned char generic_array = 0;
+    static constexpr unsigned char packed_integers = 1;
+    static constexpr unsigned char packed_doubles = 2;
+
+    template <class T>
+    using packed_t = detail::packed_array<T, array_t>;
+
+    /// the payload, either the inline value or a pointer to the heap payload
+    alignas(8) unsigned char _value[short_string_capacity];
+    /// length of an inline string or long_string for a heap string, the storage of an array
+    unsigned char _length;
+    /// the value type of the json object
+    json_t _type;
+
+public:
+    /// constructors
+    basic_json();
+    explicit basic_json(const allocator_type& alloc);
+    basic_json(const string_t& val);
+    basic_json(string_t&& val);
+    basic_json(std::string_view val, const allocator_type& alloc = allocator_type());
+    basic_json(const char* val, const allocator_type& alloc = allocator_type());
+    basic_json(double val, const allocator_type& alloc = allocator_type());
+    template <class T, typename std::enable_if<
+        std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    basic_json(T val, const allocator_type& alloc = allocator_type());
+    basic_json(bool val, const allocator_type& alloc = allocator_type());
+    basic_json(const array_t& array);
+    basic_json(array_t&& array);
+    basic_json(integer_array_t&& values);
+    basic_json(double_array_t&& values);
+    basic_json(const object_t& obj);
+    basic_json(object_t&& obj);
+
+    /// destructor
+    ~basic_json();
+
+    const json_t type() const;
+    const std::string type_name() const;
+    allocator_type get_allocator() const;
+
+    // copy constructors
+    basic_json(const basic_json& other);
+    basic_json(const basic_json& other, const allocator_type& alloc);
+    basic_json(basic_json&& other) noexcept;
+
+    // copy assignment
+    basic_json& operator= (const basic_json& other);
+    basic_json& operator= (basic_json&& other);
+    bool operator== (const basic_json& o) const;
+    bool operator!= (const basic_json& o) const;
+
+    // a hash of the content in one pass. Members are kept sorted, so objects with the
+    // same members hash the same whatever order they were added in; an integer and a
+    // double of the same value hash the same, as do packed and generic arrays.
+    // Strings, arrays and objects keep their hash until they are modified.
+    size_t hash() const;
+
+    const string_t get_string() const;
+    std::string_view get_string_view() const;
+    const long long get_integer() const;
+    const double get_double() const;
+    const bool get_bool() const;
+    const object_t& get_object() const;
+    const array_t& get_array() const;
+    const void* get_null() const;
+
+    // the values of a packed array without copying, T is long long or double.
+    // An empty array gives an empty span, any other value throws.
+    template <class T>
+    bool is_packed() const;
+    template <class T>
+    array_span<T> as_span() const;
+
+    // range access over the elements of an array
+    const_iterator begin() const;
+    const_iterator end() const;
+    iterator begin();
+    iterator end();
+    // range access over the members of an object
+    const object_t& items() const;
+    object_t& items();
+
+    size_t size() const;
+    bool has_member(std::string_view member_name) const;
+    void add_member(string_t member_name, const basic_json& member_value);
+    void add_member(string_t member_name, basic_json&& member_value);
+    void add_element(const basic_json& elem);
+    void add_element(basic_json&& elem);
+
+    // construct a member or element in place from the arguments of a basic_json
+    // constructor, an existing member is replaced like add_member does
+    template <class... Args>
+    basic_json& emplace_member(std::string_view member_name, Args&&... args);
+    template <class... Args>
+    basic_json& emplace_element(Args&&... args);
+    // makes room for n elements of an array; object members are allocated one by one,
+    // so for an object this only checks the type
+    void reserve(size_t n);
+
+    // find a member, nullptr when this is not an object or has no such member
+    basic_json* find(std::string_view key);
+    const basic_json* find(std::string_view key) const;
+
+    // operator [] for object value
+    basic_json& operator [](std::string_view key);
+    const basic_json& operator [](std::string_view key) const;
+    // string literals must not fall back to the built-in subscript through the conversions
+    basic_json& operator [](const char * key) { return (*this)[std::string_view(key)]; }
+    const basic_json& operator [](const char * key) const { return (*this)[std::string_view(key)]; }
+    // operator [int] for array value
+    basic_json& operator [](int index);
+    const basic_json& operator [](int index) const;
+
+    /// Conversion
+    operator const string_t() const;
+    operator const double() const;
+    operator const long long() const;
+    operator const bool() const;
+
+    const std::string to_string(const dump_options& options = dump_options()) const;
+    // writes the text of this value to out token by token, without building any
+    // intermediate strings, and flushes out
+    void dump(output_sink& out, const dump_options& options = dump_options()) const;
+    // the exact length of the text dump() writes, found without writing it
+    size_t serialized_size(const dump_options& options = dump_options()) const;
+    // writes the text of this value to buffer, which must have room for its serialized_size,
+    // and returns the end of it
+    char* serialize_to(char* buffer, size_t size, const dump_options& options = dump_options()) const;
+    // writes the RFC 8785 (JCS) canonical text of this value, for hashing and signing: no
+    // whitespace, members ordered by the UTF-16 code units of their keys, numbers as ES6
+    // writes doubles (integers too, past 2^53 rounded like any other), strings with only the
+    // escapes JSON requires. Throws on NaN and infinities. Flushes out.
+    void dump_canonical(output_sink& out) const;
+
+    // an immutable, contiguous copy of this value for fast concurrent reads
+    frozen_json freeze() const;
+
+    // what this value costs in memory, walking the whole tree
+    memory_usage_t memory_usage() const;
+
+private:
+    template <class T, class... Args>
+    T* create_payload(Args&&... args) const;
+    template <class T>
+    void destroy_payload(T* payload) const;
+
+    template <class T>
+    T load() const;
+    template <class T>
+    void store(T val);
+
+    template <class T>
+    detail::shared_payload<T>* payload() const { return load<detail::shared_payload<T>*>(); }
+    template <class T, class... Args>
+    void init_shared(Args&&... args);
+    template <class T>
+    void share_payload(const basic_json& other);
+    // gives this value a copy of a payload made with its own allocator, children included
+    template <class T>
+    void init_clone(const T& value);
+    void init_clone(const array_t& elems);
+    void init_clone(const object_t& members);
+    template <class T>
+    void detach_payload();
+    template <class T>
+    void unref_payload(detail::shared_payload<T>* shared) const;
+    void detach();
+
+    std::uint64_t hash_value() const;
+    // the same cell: the same scalar bits, inline string or payload
+    bool same_cell(const basic_json& other) const;
+    // exact equality, comparing children by cell as they are interned
+    bool same_interned(const basic_json& other) const;
+    template <class T>
+    bool same_packed(const basic_json& other) const;
+    // the hash kept in the payload, 0 when there is none
+    std::uint64_t known_hash() const;
+    bool hashes_differ(const basic_json& other) const;
+    bool equal_arrays(const basic_json& other) const;
+    template <class T>
+    bool equal_packed(const basic_json& other) const;
+    bool equal_objects(const basic_json& other) const;
+    template <class A>
+    friend class basic_interner;
+    template <class T>
+    static std::uint64_t cached_hash(const detail::shared_payload<T>* shared);
+    static std::uint64_t hash_payload(const string_t& s);
+    static std::uint64_t hash_payload(const array_t& elems);
+    static std::uint64_t hash_payload(const object_t& members);
+    template <class T>
+    static std::uint64_t hash_payload(const packed_t<T>& packed);
+
+    string_t* string_ptr() const { return &payload<string_t>()->value; }
+    array_t* array_ptr() const { return &payload<array_t>()->value; }
+    template <class T>
+    packed_t<T>* packed_ptr() const { return &payload<packed_t<T>>()->value; }
+    template <class T>
+    static constexpr unsigned char packed_kind() { return std::is_same<T, double>::value ? packed_doubles : packed_integers; }
+    const array_t& elements() const;
+    array_t& iterated_elements();
+    bool append_packed(const basic_json& elem);
+    template <class T>
+    bool append_packed_value(T val);
+    template <class T>
+    void unpack();
+    object_t* object_ptr() const { return &payload<object_t>()->value; }
+    bool is_long_string() const { return _length == long_string; }
+    std::string_view view_string() const;
+
+    void init_string(const char* data, size_t len);
+    void init_string(string_t&& val);
+    void copy_value(const basic_json& other);
+    void release();
+    using work_list = std::vector<basic_json, rebind_alloc<basic_json>>;
+    void release_tree();
+    void release_into(work_list& pending);
+    bool owns_tree() const;
+    void swap_contents(basic_json& other) noexcept;
+
+    void write_value(output_sink& out, const dump_options& options, size_t depth) const;
+    template <class T>
+    void write_packed(output_sink& out, const dump_options& options, size_t depth) const;
+    size_t text_size(const dump_options& options, size_t depth) const;
+    void write_canonical(output_sink& out) const;
+    template <class T>
+    size_t packed_text_size(const dump_options& options, size_t depth) const;
+
+    void add_payload_usage(memory_usage_t& usage) const;
+    template <class T>
+    void add_packed_usage(memory_usage_t& usage) const;
+    static size_t heap_bytes(const string_t& s);
+};
+
+using json = basic_json<>;
+using json_object = json::object_t;
+using json_array = json::array_t;
+
+static_assert(sizeof(json) == 16, "json values are expected to fit in a 16 byte cell");
+
+//
+// Implementation
+//
+template <class Allocator>
+inline basic_json<Allocator>::basic_json()
+    : allocator_base(allocator_type()), _value{}, _length(0), _type(json_t::null) {}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::null) {}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const string_t& val)
+    : allocator_base(val.get_allocator()), _value{}, _length(0), _type(json_t::null)
+{
+    init_string(val.data(), val.size());
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(string_t&& val)
+    : allocator_base(val.get_allocator()), _value{}, _length(0), _type(json_t::null)
+{
+    init_string(std::move(val));
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(std::string_view val, const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::null)
+{
+    init_string(val.data(), val.size());
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const char* val, const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::null)
+{
+    init_string(val, std::strlen(val));
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(double val, const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::number_double)
+{
+    store(val);
+}
+
+template <class Allocator>
+template <class T, typename std::enable_if<
+    std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type>
+inline basic_json<Allocator>::basic_json(T val, const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::number_integer)
+{
+    store(static_cast<long long>(val));
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(bool val, const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::boolean)
+{
+    store(val);
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const array_t& array)
+    : allocator_base(allocator_type(array.get_allocator())), _value{}, _length(0), _type(json_t::array)
+{
+    init_shared<array_t>(array);
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(array_t&& array)
+    : allocator_base(allocator_type(array.get_allocator())), _value{}, _length(0), _type(json_t::array)
+{
+    init_shared<array_t>(std::move(array));
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(integer_array_t&& values)
+    : allocator_base(allocator_type(values.get_allocator())), _value{}, _length(packed_integers), _type(json_t::array)
+{
+    init_shared<packed_t<long long>>(std::move(values));
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(double_array_t&& values)
+    : allocator_base(allocator_type(values.get_allocator())), _value{}, _length(packed_doubles), _type(json_t::array)
+{
+    init_shared<packed_t<double>>(std::move(values));
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const object_t& obj)
+    : allocator_base(allocator_type(obj.get_allocator())), _value{}, _length(0), _type(json_t::object)
+{
+    init_shared<object_t>(obj);
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(object_t&& obj)
+    : allocator_base(allocator_type(obj.get_allocator())), _value{}, _length(0), _type(json_t::object)
+{
+    init_shared<object_t>(std::move(obj));
+}
+
+template <class Allocator>
+inline const json_t basic_json<Allocator>::type() const { return _type; }
+
+template <class Allocator>
+inline const std::string basic_json<Allocator>::type_name() const
+{
+    switch(_type)
+    {
+        case(json_t::string):
+            return "string";
+
+        case(json_t::array):
+            return "array";
+
+        case(json_t::object):
+            return "object";
+
+        case(json_t::number_double):
+        case(json_t::number_integer):
+            return "number";
+
+        case(json_t::boolean):
+            return "boolean";
+
+        case(json_t::null):
+            return "null";
+
+        case(json_t::invalid):
+        default:
+            return "invalid";
+    }
+}
+
+template <class Allocator>
+inline typename basic_json<Allocator>::allocator_type basic_json<Allocator>::get_allocator() const
+{
+    return this->stored_allocator();
+}
+
+//
+// payloads are allocated through the json value's allocator
+//
+template <class Allocator>
+template <class T, class... Args>
+inline T* basic_json<Allocator>::create_payload(Args&&... args) const
+{
+    using traits = typename std::allocator_traits<allocator_type>::template rebind_traits<T>;
+    typename traits::allocator_type alloc(this->stored_allocator());
+
+    T* payload = traits::allocate(alloc, 1);
+    try
+    {
+        traits::construct(alloc, payload, std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+        traits::deallocate(alloc, payload, 1);
+        throw;
+    }
+
+    return payload;
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::destroy_payload(T* payload) const
+{
+    using traits = typename std::allocator_traits<allocator_type>::template rebind_traits<T>;
+    typename traits::allocator_type alloc(this->stored_allocator());
+
+    traits::destroy(alloc, payload);
+    traits::deallocate(alloc, payload, 1);
+}
+
+template <class Allocator>
+template <class T>
+inline T basic_json<Allocator>::load() const
+{
+    static_assert(sizeof(T) <= sizeof(_value), "payload does not fit in the value cell");
+
+    T val;
+    std::memcpy(&val, _value, sizeof(T));
+    return val;
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::store(T val)
+{
+    static_assert(sizeof(T) <= sizeof(_value), "payload does not fit in the value cell");
+
+    std::memcpy(_value, &val, sizeof(T));
+}
+
+template <class Allocator>
+inline std::string_view basic_json<Allocator>::view_string() const
+{
+    if (is_long_string())
+    {
+        const string_t* s = string_ptr();
+        return std::string_view(s->data(), s->size());
+    }
+
+    return std::string_view(reinterpret_cast<const char*>(_value), _length);
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::init_string(const char* data, size_t len)
+{
+    if (len <= short_string_capacity)
+    {
+        std::memcpy(_value, data, len);
+        _length = static_cast<unsigned char>(len);
+    }
+    else
+    {
+        init_shared<string_t>(data, len, get_allocator());
+        _length = long_string;
+    }
+    _type = json_t::string;
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::init_string(string_t&& val)
+{
+    if (val.size() <= short_string_capacity)
+    {
+        init_string(val.data(), val.size());
+    }
+    else
+    {
+        init_shared<string_t>(std::move(val));
+        _length = long_string;
+        _type = json_t::string;
+    }
+}
+
+//
+// copy constructor
+//
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const basic_json& other)
+    : allocator_base(std::allocator_traits<allocator_type>::select_on_container_copy_construction(other.get_allocator())),
+      _value{}, _length(0), _type(json_t::null)
+{
+    copy_value(other);
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(const basic_json& other, const allocator_type& alloc)
+    : allocator_base(alloc), _value{}, _length(0), _type(json_t::null)
+{
+    copy_value(other);
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::basic_json(basic_json&& other) noexcept
+    : allocator_base(std::move(other.stored_allocator())), _length(other._length), _type(other._type)
+{
+    std::memcpy(_value, other._value, sizeof(_value));
+    other._length = 0;
+    other._type = json_t::null;
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::copy_value(const basic_json& other)
+{
+    switch(other._type)
+    {
+        case json_t::string:
+            if (other.is_long_string())
+            {
+                share_payload<string_t>(other);
+                break;
+            }
+            // inline strings are copied with the cell
+            std::memcpy(_value, other._value, sizeof(_value));
+            break;
+        case json_t::object:
+            share_payload<object_t>(other);
+            break;
+        case json_t::array:
+            if (other._length == packed_integers)
+            {
+                share_payload<packed_t<long long>>(other);
+            }
+            else if (other._length == packed_doubles)
+            {
+                share_payload<packed_t<double>>(other);
+            }
+            else
+            {
+                share_payload<array_t>(other);
+            }
+            break;
+        case json_t::number_double:
+        case json_t::number_integer:
+        case json_t::boolean:
+        case json_t::null:
+            std::memcpy(_value, other._value, sizeof(_value));
+            break;
+        default:
+            throw std::runtime_error("unexpected json type: " + other.type_name());
+    }
+    _length = other._length;
+    _type = other._type;
+}
+
+template <class Allocator>
+template <class T, class... Args>
+inline void basic_json<Allocator>::init_shared(Args&&... args)
+{
+    store(create_payload<detail::shared_payload<T>>(std::forward<Args>(args)...));
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::share_payload(const basic_json& other)
+{
+    auto shared = other.template payload<T>();
+
+    // a payload can only be shared by values that are able to free it
+    if (get_allocator() == other.get_allocator())
+    {
+        shared->refs.fetch_add(1, std::memory_order_relaxed);
+        store(shared);
+    }
+    else
+    {
+        init_clone(shared->value);
+    }
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::init_clone(const T& value)
+{
+    init_shared<T>(value, typename T::allocator_type(get_allocator()));
+}
+
+//
+// containers are rebuilt element by element: copying them as they are would give the
+// children their own allocators back, sharing payloads with the source
+//
+template <class Allocator>
+inline void basic_json<Allocator>::init_clone(const array_t& elems)
+{
+    array_t copy{typename array_t::allocator_type(get_allocator())};
+    copy.reserve(elems.size());
+    for (const auto& elem : elems)
+    {
+        copy.emplace_back(elem, get_allocator());
+    }
+    init_shared<array_t>(std::move(copy));
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::init_clone(const object_t& members)
+{
+    object_t copy{typename object_t::allocator_type(get_allocator())};
+    for (const auto& member : members)
+    {
+        copy.emplace_hint(copy.end(), std::piecewise_construct,
+                          std::forward_as_tuple(member.first, get_allocator()),
+                          std::forward_as_tuple(member.second, get_allocator()));
+    }
+    init_shared<object_t>(std::move(copy));
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::detach_payload()
+{
+    auto shared = this->template payload<T>();
+
+    if (shared->refs.load(std::memory_order_acquire) != 1)
+    {
+        // the children of the clone share their payloads with the original
+        init_shared<T>(shared->value, typename T::allocator_type(get_allocator()));
+        unref_payload(shared);
+    }
+    else
+    {
+        // the caller is about to modify the value
+        shared->hash.store(0, std::memory_order_relaxed);
+    }
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::unref_payload(detail::shared_payload<T>* shared) const
+{
+    if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        destroy_payload(shared);
+    }
+}
+
+//
+// gives this value its own copy of a shared array or object before it is modified
+//
+template <class Allocator>
+inline void basic_json<Allocator>::detach()
+{
+    switch (_type)
+    {
+        case json_t::array:
+            // elements can only be handed out for modification by a generic array
+            if (_length == packed_integers)
+            {
+                unpack<long long>();
+            }
+            else if (_length == packed_doubles)
+            {
+                unpack<double>();
+            }
+            else
+            {
+                detach_payload<array_t>();
+            }
+            break;
+        case json_t::object:
+            detach_payload<object_t>();
+            break;
+        default:
+            // strings and scalars are never modified in place
+            break;
+    }
+}
+
+//
+// switches a packed array to generic storage, reusing its json elements when they were built
+//
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::unpack()
+{
+    auto shared = payload<packed_t<T>>();
+    array_t elems = (shared->refs.load(std::memory_order_acquire) == 1 && shared->value.elems != nullptr)
+        ? std::move(*shared->value.elems)
+        : shared->value.to_elements();
+
+    auto generic = create_payload<detail::shared_payload<array_t>>(std::move(elems));
+    unref_payload(shared);
+    store(generic);
+    _length = generic_array;
+}
+
+//
+// appends a number of the packed kind in place, false when the array has to be unpacked
+//
+template <class Allocator>
+inline bool basic_json<Allocator>::append_packed(const basic_json& elem)
+{
+    if (_length == packed_integers && elem._type == json_t::number_integer)
+    {
+        return append_packed_value(elem.load<long long>());
+    }
+    if (_length == packed_doubles && elem._type == json_t::number_double)
+    {
+        return append_packed_value(elem.load<double>());
+    }
+    return false;
+}
+
+template <class Allocator>
+template <class T>
+inline bool basic_json<Allocator>::append_packed_value(T val)
+{
+    detach_payload<packed_t<T>>();
+
+    // json elements already handed out would miss the new value
+    auto packed = packed_ptr<T>();
+    if (packed->elems != nullptr)
+    {
+        return false;
+    }
+
+    packed->values.push_back(val);
+    return true;
+}
+
+template <class Allocator>
+inline const typename basic_json<Allocator>::array_t& basic_json<Allocator>::elements() const
+{
+    if (_length == packed_integers)
+    {
+        return packed_ptr<long long>()->elements();
+    }
+    else if (_length == packed_doubles)
+    {
+        return packed_ptr<double>()->elements();
+    }
+
+    return *array_ptr();
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::swap_contents(basic_json& other) noexcept
+{
+    using std::swap;
+    swap(this->stored_allocator(), other.stored_allocator());
+    swap(_value, other._value);
+    swap(_length, other._length);
+    swap(_type, other._type);
+}
+
+//
+// copy assignment
+//
+template <class Allocator>
+inline basic_json<Allocator>& basic_json<Allocator>::operator= (const basic_json& other)
+{
+    if (this != &other)
+    {
+        constexpr bool propagate =
+            std::allocator_traits<allocator_type>::propagate_on_container_copy_assignment::value;
+
+        basic_json copy(other, propagate ? other.get_allocator() : get_allocator());
+        swap_contents(copy);
+    }
+    return *this;
+}
+
+template <class Allocator>
+inline basic_json<Allocator>& basic_json<Allocator>::operator= (basic_json&& other)
+{
+    if (this != &other)
+    {
+        constexpr bool propagate =
+            std::allocator_traits<allocator_type>::propagate_on_container_move_assignment::value;
+
+        if (propagate || get_allocator() == other.get_allocator())
+        {
+            basic_json moved(std::move(other));
+            swap_contents(moved);
+        }
+        else
+        {
+            // the payload must stay with the allocator that owns it
+            basic_json copy(other, get_allocator());
+            swap_contents(copy);
+        }
+    }
+    return *this;
+}
+
+//
+// deep equality. Numbers compare by value, so 1 == 1.0, and arrays compare by their
+// values whether they are packed or not. Values sharing a payload, different sizes
+// and differing hashes kept from earlier hash() calls all stop before the contents.
+//
+template <class Allocator>
+inline bool basic_json<Allocator>::operator==(const basic_json& o) const
+{
+    // not for doubles, a NaN is never equal
+    if (_type != json_t::number_double && same_cell(o))
+    {
+        return true;
+    }
+
+    if (_type != o._type)
+    {
+        if (_type == json_t::number_integer && o._type == json_t::number_double)
+        {
+            return detail::numbers_equal(load<long long>(), o.load<double>());
+        }
+        if (_type == json_t::number_double && o._type == json_t::number_integer)
+        {
+            return detail::numbers_equal(load<double>(), o.load<long long>());
+        }
+        return false;
+    }
+
+    switch(_type)
+    {
+        case json_t::null:
+            return true;
+
+        case json_t::boolean:
+            return load<bool>() == o.load<bool>();
+
+        case json_t::number_integer:
+            return load<long long>() == o.load<long long>();
+
+        case json_t::number_double:
+            return load<double>() == o.load<double>();
+
+        case json_t::string:
+            return !hashes_differ(o) && view_string() == o.view_string();
+
+        case json_t::array:
+            return equal_arrays(o);
+
+        case json_t::object:
+            return equal_objects(o);
+
+        default:
+            return false;
+    }
+}
+
+template <class Allocator>
+inline std::uint64_t basic_json<Allocator>::known_hash() const
+{
+    switch (_type)
+    {
+        case json_t::string:
+            return is_long_string() ? payload<string_t>()->hash.load(std::memory_order_relaxed) : 0;
+        case json_t::array:
+            if (_length == packed_integers)
+            {
+                return payload<packed_t<long long>>()->hash.load(std::memory_order_relaxed);
+            }
+            if (_length == packed_doubles)
+            {
+                return payload<packed_t<double>>()->hash.load(std::memory_order_relaxed);
+            }
+            return payload<array_t>()->hash.load(std::memory_order_relaxed);
+        case json_t::object:
+            return payload<object_t>()->hash.load(std::memory_order_relaxed);
+        default:
+            return 0;
+    }
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::hashes_differ(const basic_json& other) const
+{
+    std::uint64_t h = known_hash();
+    std::uint64_t other_h = other.known_hash();
+    return h != 0 && other_h != 0 && h != other_h;
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::equal_arrays(const basic_json& other) const
+{
+    if (size() != other.size() || hashes_differ(other))
+    {
+        return false;
+    }
+
+    // packed values are compared where they are, without building json elements
+    if (_length == packed_integers)
+    {
+        return equal_packed<long long>(other);
+    }
+    if (_length == packed_doubles)
+    {
+        return equal_packed<double>(other);
+    }
+    if (other._length == packed_integers)
+    {
+        return other.equal_packed<long long>(*this);
+    }
+    if (other._length == packed_doubles)
+    {
+        return other.equal_packed<double>(*this);
+    }
+
+    const array_t& elems = *array_ptr();
+    return std::equal(elems.begin(), elems.end(), other.array_ptr()->begin());
+}
+
+template <class Allocator>
+template <class T>
+inline bool basic_json<Allocator>::equal_packed(const basic_json& other) const
+{
+    const auto& values = packed_ptr<T>()->values;
+
+    if (other._length == packed_integers)
+    {
+        return std::equal(values.begin(), values.end(), other.packed_ptr<long long>()->values.begin(),
+                          [](T a, long long b) { return detail::numbers_equal(a, b); });
+    }
+    if (other._length == packed_doubles)
+    {
+        return std::equal(values.begin(), values.end(), other.packed_ptr<double>()->values.begin(),
+                          [](T a, double b) { return detail::numbers_equal(a, b); });
+    }
+
+    return std::equal(values.begin(), values.end(), other.array_ptr()->begin(),
+                      [](T a, const basic_json& b)
+                      {
+                          return b._type == json_t::number_integer ? detail::numbers_equal(a, b.load<long long>())
+                              : b._type == json_t::number_double && detail::numbers_equal(a, b.load<double>());
+                      });
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::equal_objects(const basic_json& other) const
+{
+    if (size() != other.size() || hashes_differ(other))
+    {
+        return false;
+    }
+
+    // members are sorted by key in both, the first differing one ends the walk
+    const object_t& members = *object_ptr();
+    return std::equal(members.begin(), members.end(), other.object_ptr()->begin(),
+                      [](const auto& a, const auto& b) { return a.first == b.first && a.second == b.second; });
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::operator!=(const basic_json& o) const
+{
+    return ! (*this == o);
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::same_cell(const basic_json& other) const
+{
+    return _type == other._type && _length == other._length &&
+           std::memcmp(_value, other._value, sizeof(_value)) == 0;
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::same_interned(const basic_json& other) const
+{
+    if (same_cell(other))
+    {
+        return true;
+    }
+    if (_type != other._type || _length != other._length)
+    {
+        return false;
+    }
+
+    switch (_type)
+    {
+        case json_t::string:
+            return view_string() == other.view_string();
+        case json_t::array:
+            if (_length == packed_integers)
+            {
+                return same_packed<long long>(other);
+            }
+            if (_length == packed_doubles)
+            {
+                return same_packed<double>(other);
+            }
+            return std::equal(array_ptr()->begin(), array_ptr()->end(),
+                              other.array_ptr()->begin(), other.array_ptr()->end(),
+                              [](const basic_json& a, const basic_json& b) { return a.same_cell(b); });
+        case json_t::object:
+            return std::equal(object_ptr()->begin(), object_ptr()->end(),
+                              other.object_ptr()->begin(), other.object_ptr()->end(),
+                              [](const auto& a, const auto& b) { return a.first == b.first && a.second.same_cell(b.second); });
+        default:
+            // scalars are equal only in the same cell
+            return false;
+    }
+}
+
+template <class Allocator>
+template <class T>
+inline bool basic_json<Allocator>::same_packed(const basic_json& other) const
+{
+    // bitwise, so 0.0 and -0.0 stay different values
+    const auto& values = packed_ptr<T>()->values;
+    const auto& other_values = other.packed_ptr<T>()->values;
+    return values.size() == other_values.size() &&
+           (values.empty() || std::memcmp(values.data(), other_values.data(), values.size() * sizeof(T)) == 0);
+}
+
+template <class Allocator>
+inline size_t basic_json<Allocator>::hash() const
+{
+    return static_cast<size_t>(hash_value());
+}
+
+template <class Allocator>
+inline std::uint64_t basic_json<Allocator>::hash_value() const
+{
+    switch (_type)
+    {
+        case json_t::null:
+            return detail::hash_mix(detail::null_seed);
+        case json_t::boolean:
+            return detail::hash_mix(detail::boolean_seed + load<bool>());
+        case json_t::number_integer:
+            return detail::hash_number(load<long long>());
+        case json_t::number_double:
+            return detail::hash_number(load<double>());
+        case json_t::string:
+            return is_long_string() ? cached_hash(payload<string_t>()) : detail::hash_string(view_string());
+        case json_t::array:
+            if (_length == packed_integers)
+            {
+                return cached_hash(payload<packed_t<long long>>());
+            }
+            if (_length == packed_doubles)
+            {
+                return cached_hash(payload<packed_t<double>>());
+            }
+            return cached_hash(payload<array_t>());
+        case json_t::object:
+            return cached_hash(payload<object_t>());
+        default:
+            throw std::runtime_error("invalid json type");
+    }
+}
+
+template <class Allocator>
+template <class T>
+inline std::uint64_t basic_json<Allocator>::cached_hash(const detail::shared_payload<T>* shared)
+{
+    // readers racing here compute and store the same value
+    std::uint64_t h = shared->hash.load(std::memory_order_relaxed);
+    if (h == 0)
+    {
+        h = hash_payload(shared->value);
+        h = (h == 0) ? 1 : h;
+        shared->hash.store(h, std::memory_order_relaxed);
+    }
+    return h;
+}
+
+template <class Allocator>
+inline std::uint64_t basic_json<Allocator>::hash_payload(const string_t& s)
+{
+    return detail::hash_string(std::string_view(s.data(), s.size()));
+}
+
+template <class Allocator>
+inline std::uint64_t basic_json<Allocator>::hash_payload(const array_t& elems)
+{
+    std::uint64_t h = detail::hash_combine(detail::array_seed, elems.size());
+    for (const auto& elem : elems)
+    {
+        h = detail::hash_combine(h, elem.hash_value());
+    }
+    return h;
+}
+
+template <class Allocator>
+template <class T>
+inline std::uint64_t basic_json<Allocator>::hash_payload(const packed_t<T>& packed)
+{
+    // the same as the generic array of the same numbers
+    std::uint64_t h = detail::hash_combine(detail::array_seed, packed.values.size());
+    for (T val : packed.values)
+    {
+        h = detail::hash_combine(h, detail::hash_number(val));
+    }
+    return h;
+}
+
+template <class Allocator>
+inline std::uint64_t basic_json<Allocator>::hash_payload(const object_t& members)
+{
+    std::uint64_t h = detail::hash_combine(detail::object_seed, members.size());
+    for (const auto& member : members)
+    {
+        h = detail::hash_combine(h, detail::hash_string(std::string_view(member.first.data(), member.first.size())));
+        h = detail::hash_combine(h, member.second.hash_value());
+    }
+    return h;
+}
+
+//
+// belows method are for retrieving json values
+//
+template <class Allocator>
+inline const typename basic_json<Allocator>::string_t basic_json<Allocator>::get_string() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::string);
+    std::string_view s = view_string();
+    return string_t(s.data(), s.size(), get_allocator());
+}
+
+template <class Allocator>
+inline const long long basic_json<Allocator>::get_integer() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::number_integer);
+    return load<long long>();
+}
+
+template <class Allocator>
+inline const double basic_json<Allocator>::get_double() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::number_double);
+    return load<double>();
+}
+
+template <class Allocator>
+inline const bool basic_json<Allocator>::get_bool() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::boolean);
+    return load<bool>();
+}
+
+template <class Allocator>
+inline std::string_view basic_json<Allocator>::get_string_view() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::string);
+    return view_string();
+}
+
+template <class Allocator>
+inline const typename basic_json<Allocator>::object_t& basic_json<Allocator>::get_object() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    return *object_ptr();
+}
+
+template <class Allocator>
+inline const typename basic_json<Allocator>::array_t& basic_json<Allocator>::get_array() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+    return elements();
+}
+
+template <class Allocator>
+template <class T>
+inline bool basic_json<Allocator>::is_packed() const
+{
+    static_assert(std::is_same<T, long long>::value || std::is_same<T, double>::value,
+                  "packed arrays hold long long or double");
+    return _type == json_t::array && _length == packed_kind<T>();
+}
+
+template <class Allocator>
+template <class T>
+inline array_span<T> basic_json<Allocator>::as_span() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+
+    if (is_packed<T>())
+    {
+        auto& values = packed_ptr<T>()->values;
+        return array_span<T>(values.data(), values.size());
+    }
+
+    if (size() == 0)
+    {
+        return array_span<T>();
+    }
+
+    throw std::runtime_error("array is not packed as " + std::string(std::is_same<T, double>::value ? "double" : "integer"));
+}
+
+template <class Allocator>
+inline const void* basic_json<Allocator>::get_null() const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::null);
+    return nullptr;
+}
+
+//
+// range access, the non-const versions give this value its own payload first unless
+// it is a packed array
+//
+template <class Allocator>
+inline typename basic_json<Allocator>::const_iterator basic_json<Allocator>::begin() const
+{
+    return get_array().begin();
+}
+
+template <class Allocator>
+inline typename basic_json<Allocator>::const_iterator basic_json<Allocator>::end() const
+{
+    return get_array().end();
+}
+
+template <class Allocator>
+inline typename basic_json<Allocator>::iterator basic_json<Allocator>::begin()
+{
+    return iterated_elements().begin();
+}
+
+template <class Allocator>
+inline typename basic_json<Allocator>::iterator basic_json<Allocator>::end()
+{
+    return iterated_elements().end();
+}
+
+//
+// the elements for non-const iteration. A packed array is not unpacked for a loop,
+// which mostly only reads it: its shared, read-only elements are handed out.
+//
+template <class Allocator>
+inline typename basic_json<Allocator>::array_t& basic_json<Allocator>::iterated_elements()
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+    if (_length != generic_array)
+    {
+        return const_cast<array_t&>(elements());
+    }
+    detach();
+    return *array_ptr();
+}
+
+template <class Allocator>
+inline const typename basic_json<Allocator>::object_t& basic_json<Allocator>::items() const
+{
+    return get_object();
+}
+
+template <class Allocator>
+inline typename basic_json<Allocator>::object_t& basic_json<Allocator>::items()
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    detach();
+    return *object_ptr();
+}
+
+template <class Allocator>
+inline bool basic_json<Allocator>::has_member(std::string_view member_name) const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    auto members = object_ptr();
+    return (members->find(member_name) != members->end());
+}
+
+template <class Allocator>
+inline basic_json<Allocator>* basic_json<Allocator>::find(std::string_view key)
+{
+    if (_type != json_t::object)
+    {
+        return nullptr;
+    }
+
+    detach();
+    return const_cast<basic_json*>(std::as_const(*this).find(key));
+}
+
+template <class Allocator>
+inline const basic_json<Allocator>* basic_json<Allocator>::find(std::string_view key) const
+{
+    if (_type != json_t::object)
+    {
+        return nullptr;
+    }
+
+    const object_t* members = object_ptr();
+    auto it = members->find(key);
+    return it == members->end() ? nullptr : &it->second;
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::add_member(string_t member_name, const basic_json& member_value)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    detach();
+    auto members = object_ptr();
+    members->insert_or_assign(std::move(member_name), member_value);
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::add_member(string_t member_name, basic_json&& member_value)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    detach();
+    auto members = object_ptr();
+    members->insert_or_assign(std::move(member_name), std::move(member_value));
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::add_element(const basic_json& elem)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+    if (append_packed(elem))
+    {
+        return;
+    }
+    detach();
+    auto elems = array_ptr();
+    elems->push_back(elem);
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::add_element(basic_json&& elem)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+    if (append_packed(elem))
+    {
+        return;
+    }
+    detach();
+    auto elems = array_ptr();
+    elems->push_back(std::move(elem));
+}
+
+template <class Allocator>
+template <class... Args>
+inline basic_json<Allocator>& basic_json<Allocator>::emplace_member(std::string_view member_name, Args&&... args)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    detach();
+    auto members = object_ptr();
+
+    // the key is only materialized when the member is new
+    auto it = members->lower_bound(member_name);
+    if (it != members->end() && it->first == member_name)
+    {
+        it->second = basic_json(std::forward<Args>(args)...);
+        return it->second;
+    }
+
+    it = members->emplace_hint(it, std::piecewise_construct,
+                               std::forward_as_tuple(member_name.data(), member_name.size(), get_allocator()),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+    return it->second;
+}
+
+template <class Allocator>
+template <class... Args>
+inline basic_json<Allocator>& basic_json<Allocator>::emplace_element(Args&&... args)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+    detach();
+    auto elems = array_ptr();
+    return elems->emplace_back(std::forward<Args>(args)...);
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::reserve(size_t n)
+{
+    if (_type == json_t::array)
+    {
+        if (_length == packed_integers)
+        {
+            detach_payload<packed_t<long long>>();
+            packed_ptr<long long>()->values.reserve(n);
+            return;
+        }
+        if (_length == packed_doubles)
+        {
+            detach_payload<packed_t<double>>();
+            packed_ptr<double>()->values.reserve(n);
+            return;
+        }
+        detach();
+        array_ptr()->reserve(n);
+        return;
+    }
+
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+}
+
+template <class Allocator>
+inline size_t basic_json<Allocator>::size() const
+{
+    if (_type == json_t::array)
+    {
+        if (_length == packed_integers)
+        {
+            return packed_ptr<long long>()->values.size();
+        }
+        if (_length == packed_doubles)
+        {
+            return packed_ptr<double>()->values.size();
+        }
+        auto array = array_ptr();
+        return array->size();
+    }
+    else if (_type == json_t::object)
+    {
+        auto members = object_ptr();
+        return members->size();
+    }
+
+    throw std::runtime_error("Unexpeced json type " + type_name() + ", expected array or object");
+}
+
+// operator [] for object value
+template <class Allocator>
+inline basic_json<Allocator>& basic_json<Allocator>::operator [](std::string_view key)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    detach();
+
+    return const_cast<basic_json&>(std::as_const(*this)[key]);
+}
+
+template <class Allocator>
+inline const basic_json<Allocator>& basic_json<Allocator>::operator [](std::string_view key) const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+
+    const object_t* members = object_ptr();
+    auto it = members->find(key);
+    if (it == members->end())
+    {
+        throw std::runtime_error("key " + std::string(key) + " not found.");
+    }
+
+    return it->second;
+}
+
+// operator [int] for array value
+template <class Allocator>
+inline basic_json<Allocator>& basic_json<Allocator>::operator[](int index)
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+    detach();
+
+    return const_cast<basic_json&>(std::as_const(*this)[index]);
+}
+
+template <class Allocator>
+inline const basic_json<Allocator>& basic_json<Allocator>::operator[](int index) const
+{
+    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+
+    const array_t* array = &elements();
+    if (index < 0 || (size_t)index >= array->size())
+    {
+        throw std::runtime_error("index " + std::to_string(index) + " out of range.");
+    }
+
+    return (*array)[index];
+}
+
+/// destructor
+template <class Allocator>
+inline basic_json<Allocator>::~basic_json()
+{
+    release();
+}
+
+//
+// frees the payload without recursion: the arrays and objects that go with it are
+// moved to a work list and freed one by one, so the depth of a document does not
+// matter to the stack
+//
+template <class Allocator>
+inline void basic_json<Allocator>::release()
+{
+    switch (_type)
+    {
+        case (json_t::array):
+            if (_length == packed_integers)
+            {
+                unref_payload(payload<packed_t<long long>>());
+            }
+            else if (_length == packed_doubles)
+            {
+                unref_payload(payload<packed_t<double>>());
+            }
+            else
+            {
+                release_tree();
+            }
+            break;
+        case (json_t::object):
+            release_tree();
+            break;
+        case (json_t::string):
+            if (is_long_string())
+            {
+                unref_payload(payload<string_t>());
+            }
+            break;
+        default:
+            // scalars live in the cell
+            break;
+    }
+
+    _length = 0;
+    _type = json_t::null;
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::release_tree()
+{
+    work_list pending{typename work_list::allocator_type(get_allocator())};
+    release_into(pending);
+
+    while (!pending.empty())
+    {
+        basic_json node(std::move(pending.back()));
+        pending.pop_back();
+        node.release_into(pending);
+    }
+}
+
+//
+// drops this generic array's or object's reference. When it was the last one, the
+// children that would be freed along with the payload are moved to pending first.
+//
+template <class Allocator>
+inline void basic_json<Allocator>::release_into(work_list& pending)
+{
+    auto take = [&pending](basic_json& child)
+    {
+        if (child.owns_tree())
+        {
+            try
+            {
+                pending.push_back(std::move(child));
+            }
+            catch(...)
+            {
+                // no room in the work list, the child goes with its parent after all
+            }
+        }
+    };
+
+    if (_type == json_t::object)
+    {
+        auto shared = payload<object_t>();
+        if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            for (auto& member : shared->value)
+            {
+                take(member.second);
+            }
+            destroy_payload(shared);
+        }
+    }
+    else
+    {
+        auto shared = payload<array_t>();
+        if (shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            for (auto& elem : shared->value)
+            {
+                take(elem);
+            }
+            destroy_payload(shared);
+        }
+    }
+
+    _length = 0;
+    _type = json_t::null;
+}
+
+// a generic array or object that is freed together with this value
+template <class Allocator>
+inline bool basic_json<Allocator>::owns_tree() const
+{
+    if (_type == json_t::object)
+    {
+        return payload<object_t>()->refs.load(std::memory_order_relaxed) == 1;
+    }
+    if (_type == json_t::array && _length == generic_array)
+    {
+        return payload<array_t>()->refs.load(std::memory_order_relaxed) == 1;
+    }
+    return false;
+}
+
+/// Conversion
+template <class Allocator>
+inline basic_json<Allocator>::operator const string_t() const
+{
+    switch (_type)
+    {
+        case json_t::string:
+            return get_string();
+        default:
+            throw std::runtime_error("cannot cast " + type_name() + " to json string");
+    }
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::operator const double() const
+{
+    switch (_type)
+    {
+        case json_t::number_double:
+            return load<double>();
+        default:
+            throw std::runtime_error("cannot cast " + type_name() + " to json number");
+    }
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::operator const long long() const
+{
+    switch (_type)
+    {
+        case json_t::number_integer:
+            return load<long long>();
+        default:
+            throw std::runtime_error("cannot cast " + type_name() + " to json number");
+    }
+}
+
+template <class Allocator>
+inline basic_json<Allocator>::operator const bool() const
+{
+    switch (_type)
+    {
+        case json_t::boolean:
+            return load<bool>();
+        default:
+            throw std::runtime_error("cannot cast " + type_name() + " to json boolean");
+    }
+}
+
+template <class Allocator>
+inline const std::string basic_json<Allocator>::to_string(const dump_options& options) const
+{
+    std::string text;
+    {
+        // the sink trims text when it goes away
+        string_sink<std::string> out(text);
+        dump(out, options);
+    }
+    return text;
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::dump(output_sink& out, const dump_options& options) const
+{
+    write_value(out, options, 0);
+    out.flush();
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::write_value(output_sink& out, const dump_options& options, size_t depth) const
+{
+    switch(_type)
+    {
+        case json_t::object:
+        {
+            if (object_ptr()->empty())
+            {
+                out.write("{}", 2);
+                break;
+            }
+
+            out.put('{');
+            bool first = true;
+            for (const auto& member : *object_ptr())
+            {
+                if (!first)
+                {
+                    out.put(',');
+                }
+                first = false;
+
+                detail::write_line_break(out, options, depth + 1);
+                detail::write_string(out, std::string_view(member.first.data(), member.first.size()),
+                                     options.ascii_only, true);
+                options.pretty ? out.write(": ", 2) : out.put(':');
+                member.second.write_value(out, options, depth + 1);
+            }
+            detail::write_line_break(out, options, depth);
+            out.put('}');
+            break;
+        }
+
+        case json_t::array:
+        {
+            if (_length == packed_integers)
+            {
+                write_packed<long long>(out, options, depth);
+                break;
+            }
+            if (_length == packed_doubles)
+            {
+                write_packed<double>(out, options, depth);
+                break;
+            }
+            if (array_ptr()->empty())
+            {
+                out.write("[]", 2);
+                break;
+            }
+
+            out.put('[');
+            bool first = true;
+            for (const auto& elem : *array_ptr())
+            {
+                if (!first)
+                {
+                    out.put(',');
+                }
+                first = false;
+
+                detail::write_line_break(out, options, depth + 1);
+                elem.write_value(out, options, depth + 1);
+            }
+            detail::write_line_break(out, options, depth);
+            out.put(']');
+            break;
+        }
+
+        case json_t::string:
+            detail::write_string(out, view_string(), options.ascii_only, true);
+            break;
+
+        case json_t::number_integer:
+            detail::write_integer(out, load<long long>());
+            break;
+
+        case json_t::number_double:
+            detail::write_double(out, load<double>());
+            break;
+
+        case json_t::boolean:
+            out.write(load<bool>() ? std::string_view("true") : std::string_view("false"));
+            break;
+
+        case json_t::null:
+            out.write("null", 4);
+            break;
+
+        default:
+            throw std::runtime_error("invalid json type");
+    }
+}
+
+// packed values are written as they are, without building their json elements
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::write_packed(output_sink& out, const dump_options& options, size_t depth) const
+{
+    const auto& values = packed_ptr<T>()->values;
+    if (values.empty())
+    {
+        out.write("[]", 2);
+        return;
+    }
+
+    out.put('[');
+    bool first = true;
+    for (T val : values)
+    {
+        if (!first)
+        {
+            out.put(',');
+        }
+        first = false;
+
+        detail::write_line_break(out, options, depth + 1);
+        if constexpr (std::is_same<T, double>::value)
+        {
+            detail::write_double(out, val);
+        }
+        else
+        {
+            detail::write_integer(out, val);
+        }
+    }
+    detail::write_line_break(out, options, depth);
+    out.put(']');
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::dump_canonical(output_sink& out) const
+{
+    write_canonical(out);
+    out.flush();
+}
+
+template <class Allocator>
+inline void basic_json<Allocator>::write_canonical(output_sink& out) const
+{
+    switch(_type)
+    {
+        case json_t::object:
+        {
+            const object_t& members = *object_ptr();
+            auto write_member = [&out](const typename object_t::value_type& member, bool first) {
+                if (!first)
+                {
+                    out.put(',');
+                }
+                detail::write_string(out, std::string_view(member.first.data(), member.first.size()), false, true);
+                out.put(':');
+                member.second.write_canonical(out);
+            };
+
+            out.put('{');
+            bool in_order = std::all_of(members.begin(), members.end(), [](const auto& member) {
+                return detail::has_utf16_order(std::string_view(member.first.data(), member.first.size()));
+            });
+            if (in_order)
+            {
+                bool first = true;
+                for (const auto& member : members)
+                {
+                    write_member(member, first);
+                    first = false;
+                }
+            }
+            else
+            {
+                std::vector<const typename object_t::value_type*> sorted;
+                sorted.reserve(members.size());
+                for (const auto& member : members)
+                {
+                    sorted.push_back(&member);
+                }
+                std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+                    return detail::utf16_less(std::string_view(a->first.data(), a->first.size()),
+                                              std::string_view(b->first.data(), b->first.size()));
+                });
+                for (size_t i = 0; i < sorted.size(); i++)
+                {
+                    write_member(*sorted[i], i == 0);
+                }
+            }
+            out.put('}');
+            break;
+        }
+
+        case json_t::array:
+        {
+            out.put('[');
+            if (_length == packed_integers || _length == packed_doubles)
+            {
+                bool first = true;
+                auto write_number = [&out, &first](double val) {
+                    if (!first)
+                    {
+                        out.put(',');
+                    }
+                    first = false;
+                    detail::write_canonical_number(out, val);
+                };
+                if (_length == packed_integers)
+                {
+                    for (long long val : packed_ptr<long long>()->values)
+                    {
+                        write_number(static_cast<double>(val));
+                    }
+                }
+                else
+                {
+                    for (double val : packed_ptr<double>()->values)
+                    {
+                        write_number(val);
+                    }
+                }
+            }
+            else
+            {
+                bool first = true;
+                for (const auto& elem : *array_ptr())
+                {
+                    if (!first)
+                    {
+                        out.put(',');
+                    }
+                    first = false;
+                    elem.write_canonical(out);
+                }
+            }
+            out.put(']');
+            break;
+        }
+
+        case json_t::string:
+            detail::write_string(out, view_string(), false, true);
+            break;
+
+        case json_t::number_integer:
+            detail::write_canonical_number(out, static_cast<double>(load<long long>()));
+            break;
+
+        case json_t::number_double:
+            detail::write_canonical_number(out, load<double>());
+            break;
+
+        case json_t::boolean:
+            out.write(load<bool>() ? std::string_view("true") : std::string_view("false"));
+            break;
+
+        case json_t::null:
+            out.write("null", 4);
+            break;
+
+        default:
+            throw std::runtime_error("invalid json type");
+    }
+}
+
+template <class Allocator>
+inline size_t basic_json<Allocator>::serialized_size(const dump_options& options) const
+{
+    return text_size(options, 0);
+}
+
+template <class Allocator>
+inline char* basic_json<Allocator>::serialize_to(char* buffer, size_t size, const dump_options& options) const
+{
+    // with the size known, the sink never runs out and never grows
+    buffer_sink out(buffer, size);
+    write_value(out, options, 0);
+    return buffer + out.size();
+}
+
+// mirrors write_value token by token
+template <class Allocator>
+inline size_t basic_json<Allocator>::text_size(const dump_options& options, size_t depth) const
+{
+    switch(_type)
+    {
+        case json_t::object:
+        {
+            const object_t& members = *object_ptr();
+            if (members.empty())
+            {
+                return 2;
+            }
+
+            // braces, commas, colons and the spaces after them
+            size_t size = 2 + (members.size() - 1) + members.size() * (options.pretty ? 2 : 1);
+            size += members.size() * detail::line_break_size(options, depth + 1) + detail::line_break_size(options, depth);
+            for (const auto& member : members)
+            {
+                size += detail::string_text_size(std::string_view(member.first.data(), member.first.size()),
+                                                 options.ascii_only);
+                size += member.second.text_size(options, depth + 1);
+            }
+            return size;
+        }
+
+        case json_t::array:
+        {
+            if (_length == packed_integers)
+            {
+                return packed_text_size<long long>(options, depth);
+            }
+            if (_length == packed_doubles)
+            {
+                return packed_text_size<double>(options, depth);
+            }
+
+            const array_t& elems = *array_ptr();
+            if (elems.empty())
+            {
+                return 2;
+            }
+
+            size_t size = 2 + (elems.size() - 1);
+            size += elems.size() * detail::line_break_size(options, depth + 1) + detail::line_break_size(options, depth);
+            for (const auto& elem : elems)
+            {
+                size += elem.text_size(options, depth + 1);
+            }
+            return size;
+        }
+
+        case json_t::string:
+            return detail::string_text_size(view_string(), options.ascii_only);
+
+        case json_t::number_integer:
+            return detail::integer_text_size(load<long long>());
+
+        case json_t::number_double:
+            return detail::double_text_size(load<double>());
+
+        case json_t::boolean:
+            return load<bool>() ? 4 : 5;
+
+        case json_t::null:
+            return 4;
+
+        default:
+            throw std::runtime_error("invalid json type");
+    }
+}
+
+template <class Allocator>
+template <class T>
+inline size_t basic_json<Allocator>::packed_text_size(const dump_options& options, size_t depth) const
+{
+    const auto& values = packed_ptr<T>()->values;
+    if (values.empty())
+    {
+        return 2;
+    }
+
+    size_t size = 2 + (values.size() - 1);
+    size += values.size() * detail::line_break_size(options, depth + 1) + detail::line_break_size(options, depth);
+    for (T val : values)
+    {
+        if constexpr (std::is_same<T, double>::value)
+        {
+            size += detail::double_text_size(val);
+        }
+        else
+        {
+            size += detail::integer_text_size(val);
+        }
+    }
+    return size;
+}
+
+template <class Allocator>
+inline memory_usage_t basic_json<Allocator>::memory_usage() const
+{
+    memory_usage_t usage;
+    usage.values += sizeof(basic_json);
+    usage.by_type[_type] += sizeof(basic_json);
+    add_payload_usage(usage);
+
+    usage.total = usage.values + usage.strings + usage.keys + usage.containers + usage.packed;
+    return usage;
+}
+
+//
+// adds the heap bytes below this value's cell, the cell itself is counted by its owner
+//
+template <class Allocator>
+inline void basic_json<Allocator>::add_payload_usage(memory_usage_t& usage) const
+{
+    switch (_type)
+    {
+        case json_t::string:
+        {
+            if (is_long_string())
+            {
+                size_t bytes = sizeof(detail::shared_payload<string_t>) + heap_bytes(*string_ptr());
+                usage.strings += bytes;
+                usage.by_type[json_t::string] += bytes;
+            }
+            break;
+        }
+
+        case json_t::array:
+        {
+            if (_length == packed_integers)
+            {
+                add_packed_usage<long long>(usage);
+                break;
+            }
+            if (_length == packed_doubles)
+            {
+                add_packed_usage<double>(usage);
+                break;
+            }
+
+            const array_t* elems = array_ptr();
+            size_t bytes = sizeof(detail::shared_payload<array_t>) +
+                           (elems->capacity() - elems->size()) * sizeof(basic_json);
+            usage.containers += bytes;
+            usage.by_type[json_t::array] += bytes;
+
+            for (auto& elem : *elems)
+            {
+                usage.values += sizeof(basic_json);
+                usage.by_type[elem._type] += sizeof(basic_json);
+                elem.add_payload_usage(usage);
+            }
+            break;
+        }
+
+        case json_t::object:
+        {
+            // a map node is the tree links and color of libstdc++, libc++ and MSVC,
+            // then the key and value pair
+            constexpr size_t node_links = 4 * sizeof(void*);
+            constexpr size_t key_bytes = sizeof(typename object_t::value_type) - sizeof(basic_json);
+
+            const object_t* members = object_ptr();
+            size_t links = sizeof(detail::shared_payload<object_t>) + members->size() * node_links;
+#ifdef _MSC_VER
+            // MSVC allocates the head node of every map as well
+            links += node_links + sizeof(typename object_t::value_type);
+#endif
+            usage.containers += links;
+            usage.by_type[json_t::object] += links;
+
+            for (auto& [key, value] : *members)
+            {
+                size_t bytes = key_bytes + heap_bytes(key);
+                usage.keys += bytes;
+                usage.by_type[json_t::object] += bytes;
+
+                usage.values += sizeof(basic_json);
+                usage.by_type[value._type] += sizeof(basic_json);
+                value.add_payload_usage(usage);
+            }
+            break;
+        }
+
+        default:
+            // scalars live in the cell
+            break;
+    }
+}
+
+template <class Allocator>
+template <class T>
+inline void basic_json<Allocator>::add_packed_usage(memory_usage_t& usage) const
+{
+    const packed_t<T>* packed = packed_ptr<T>();
+    size_t values = packed->values.size() * sizeof(T);
+    size_t overhead = sizeof(detail::shared_payload<packed_t<T>>) +
+                      (packed->values.capacity() - packed->values.size()) * sizeof(T);
+
+    if (packed->elems != nullptr)
+    {
+        overhead += sizeof(array_t) + packed->elems->capacity() * sizeof(basic_json);
+    }
+
+    usage.packed += values;
+    usage.containers += overhead;
+    usage.by_type[json_t::array] += values + overhead;
+}
+
+// the buffer a string allocated, nothing when its characters are stored in the object
+template <class Allocator>
+inline size_t basic_json<Allocator>::heap_bytes(const string_t& s)
+{
+    const char* object = reinterpret_cast<const char*>(&s);
+    if (s.data() >= object && s.data() < object + sizeof(string_t))
+    {
+        return 0;
+    }
+    return s.capacity() + 1;
+}
+
+//
+// frozen_json: an immutable copy of a json document packed into one contiguous block.
+// Every object carries a minimal perfect hash of its keys, so a member lookup costs
+// one hash and one key compare. Nothing changes after construction, so any number
+// of threads can read a frozen_json without locking.
+//
+class frozen_json
+{
+public:
+    class value;
+
+    template <class Allocator>
+    explicit frozen_json(const basic_json<Allocator>& doc);
+
+    frozen_json(frozen_json&& other) noexcept = default;
+    frozen_json& operator= (frozen_json&& other) noexcept = default;
+
+    value root() const;
+    value operator [](std::string_view key) const;
+    value operator [](const char * key) const;
+    value operator [](int index) const;
+
+    // bytes used by the block
+    size_t block_size() const { return _words * sizeof(std::uint64_t); }
+
+private:
+    struct builder;
+
+    // node layout: word 0 is the type tag and the string length or element count,
+    // word 1 the scalar, the string offset or the word index of the children
+    static constexpr size_t node_words = 2;
+    // object slot layout: key offset, key length, then the value node
+    static constexpr size_t slot_words = 2 + node_words;
+    static constexpr std::uint64_t empty_slot = ~std::uint64_t(0);
+
+    static std::uint64_t hash(std::string_view key, std::uint64_t seed);
+    static size_t slot_of(std::uint64_t h, std::uint32_t displacement, size_t slots);
+
+    std::uint64_t word(size_t index) const { return _block[index]; }
+    std::string_view chars(std::uint64_t offset, std::uint64_t length) const;
+
+    std::unique_ptr<std::uint64_t[]> _block;
+    size_t _words;
+    // word index where the string bytes start
+    size_t _chars;
+};
+
+//
+// a view of one value inside a frozen_json, valid as long as the frozen_json lives
+//
+class frozen_json::value
+{
+public:
+    const json_t type() const;
+    const std::string type_name() const;
+
+    const std::string get_string() const;
+    std::string_view get_string_view() const;
+    const long long get_integer() const;
+    const double get_double() const;
+    const bool get_bool() const;
+    const void* get_null() const;
+
+    size_t size() const;
+    bool has_member(std::string_view key) const;
+    // non-throwing lookup, the value is empty when the member is missing
+    std::optional<value> find(std::string_view key) const;
+
+    value operator [](std::string_view key) const;
+    value operator [](const char * key) const { return (*this)[std::string_view(key)]; }
+    value operator [](int index) const;
+
+private:
+    friend class frozen_json;
+
+    value(const frozen_json* doc, size_t node) : _doc(doc), _node(node) {}
+
+    std::uint64_t count() const { return _doc->word(_node) >> 8; }
+    std::uint64_t payload() const { return _doc->word(_node + 1); }
+
+    const frozen_json* _doc;
+    size_t _node;
+};
+
+struct frozen_json::builder
+{
+    static constexpr size_t no_entry = ~size_t(0);
+
+    std::vector<std::uint64_t> words;
+    std::string chars;
+
+    size_t reserve(size_t count)
+    {
+        size_t at = words.size();
+        words.resize(at + count, 0);
+        return at;
+    }
+
+    std::uint64_t add_chars(std::string_view s)
+    {
+        std::uint64_t offset = chars.size();
+        chars.append(s.data(), s.size());
+        return offset;
+    }
+
+    void set_node(size_t node, json_t type, std::uint64_t count, std::uint64_t payload)
+    {
+        words[node] = static_cast<std::uint64_t>(type) | (count << 8);
+        words[node + 1] = payload;
+    }
+
+    template <class Json>
+    void write_value(const Json& j, size_t node);
+
+    template <class Json>
+    void write_object(const Json& j, size_t node);
+};
+
+template <class Json>
+inline void frozen_json::builder::write_value(const Json& j, size_t node)
+{
+    switch (j.type())
+    {
+        case json_t::string:
+        {
+            std::string_view s = j.get_string_view();
+            set_node(node, json_t::string, s.size(), add_chars(s));
+            break;
+        }
+
+        case json_t::number_integer:
+            set_node(node, json_t::number_integer, 0, static_cast<std::uint64_t>(j.get_integer()));
+            break;
+
+        case json_t::number_double:
+        {
+            double d = j.get_double();
+            std::uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            set_node(node, json_t::number_double, 0, bits);
+            break;
+        }
+
+        case json_t::boolean:
+            set_node(node, json_t::boolean, 0, j.get_bool() ? 1 : 0);
+            break;
+
+        case json_t::null:
+            set_node(node, json_t::null, 0, 0);
+            break;
+
+        case json_t::array:
+        {
+            // elements are consecutive nodes
+            size_t first = reserve(j.size() * node_words);
+            set_node(node, json_t::array, j.size(), first);
+
+            size_t elem_node = first;
+            if (j.template is_packed<long long>())
+            {
+                for (long long val : j.template as_span<long long>())
+                {
+                    set_node(elem_node, json_t::number_integer, 0, static_cast<std::uint64_t>(val));
+                    elem_node += node_words;
+                }
+                break;
+            }
+            if (j.template is_packed<double>())
+            {
+                for (double val : j.template as_span<double>())
+                {
+                    std::uint64_t bits;
+                    std::memcpy(&bits, &val, sizeof(bits));
+                    set_node(elem_node, json_t::number_double, 0, bits);
+                    elem_node += node_words;
+                }
+                break;
+            }
+
+            for (auto& elem : j)
+            {
+                write_value(elem, elem_node);
+                elem_node += node_words;
+            }
+            break;
+        }
+
+        case json_t::object:
+            write_object(j, node);
+            break;
+
+        default:
+            throw std::runtime_error("unexpected json type: " + j.type_name());
+    }
+}
+
+//
+// Builds a hash-and-displace perfect hash: keys are spread over buckets by the high
+// bits of their hash, then every bucket, largest first, searches for the displacement
+// that sends all of its keys to free slots. The slots are laid out as
+// [seed][buckets | slots << 32][displacements, two per word][slot 0]...[slot n-1]
+//
+template <class Json>
+inline void frozen_json::builder::write_object(const Json& j, size_t node)
+{
+    struct entry
+    {
+        std::string_view key;
+        const Json* value;
+        std::uint64_t hash;
+    };
+
+    std::vector<entry> entries;
+    entries.reserve(j.size());
+    for (auto& [key, value] : j.items())
+    {
+        entries.push_back(entry{std::string_view(key.data(), key.size()), &value, 0});
+    }
+
+    const size_t n = entries.size();
+    const size_t buckets = n / 4 + 1;
+
+    std::uint64_t seed = 0;
+    size_t slots = n;
+    std::vector<std::uint32_t> displacements;
+    std::vector<size_t> slot_entry;
+
+    for (int attempt = 0; ; attempt++)
+    {
+        seed = hash(std::string_view(), attempt);
+        // a minimal table is found almost always, a sparser one is the fallback
+        slots = attempt < 16 ? n : n * 2;
+
+        std::vector<std::vector<size_t>> bucket_entries(buckets);
+        for (size_t i = 0; i < n; i++)
+        {
+            entries[i].hash = hash(entries[i].key, seed);
+            bucket_entries[(entries[i].hash >> 40) % buckets].push_back(i);
+        }
+
+        std::vector<size_t> order(buckets);
+        for (size_t b = 0; b < buckets; b++)
+        {
+            order[b] = b;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            return bucket_entries[a].size() > bucket_entries[b].size();
+        });
+
+        displacements.assign(buckets, 0);
+        slot_entry.assign(slots, no_entry);
+        std::vector<size_t> taken;
+
+        bool found_all = true;
+        const std::uint64_t max_displacement = 16 * slots + 1024;
+
+        for (size_t b : order)
+        {
+            auto& bucket = bucket_entries[b];
+            if (bucket.empty())
+            {
+                break;
+            }
+
+            bool placed = false;
+            for (std::uint64_t d = 0; d < max_displacement && !placed; d++)
+            {
+                taken.clear();
+                placed = true;
+                for (size_t i : bucket)
+                {
+                    size_t slot = slot_of(entries[i].hash, static_cast<std::uint32_t>(d), slots);
+                    if (slot_entry[slot] != no_entry ||
+                        std::find(taken.begin(), taken.end(), slot) != taken.end())
+                    {
+                        placed = false;
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+
+                if (placed)
+                {
+                    displacements[b] = static_cast<std::uint32_t>(d);
+                    for (size_t k = 0; k < bucket.size(); k++)
+                    {
+                        slot_entry[taken[k]] = bucket[k];
+                    }
+                }
+            }
+
+            if (!placed)
+            {
+                found_all = false;
+                break;
+            }
+        }
+
+        if (found_all)
+        {
+            break;
+        }
+    }
+
+    size_t header = reserve(2 + (buckets + 1) / 2 + slots * slot_words);
+    set_node(node, json_t::object, n, header);
+
+    words[header] = seed;
+    words[header + 1] = static_cast<std::uint64_t>(buckets) | (static_cast<std::uint64_t>(slots) << 32);
+    for (size_t b = 0; b < buckets; b++)
+    {
+        words[header + 2 + b / 2] |= static_cast<std::uint64_t>(displacements[b]) << (32 * (b % 2));
+    }
+
+    size_t first_slot = header + 2 + (buckets + 1) / 2;
+    for (size_t slot = 0; slot < slots; slot++)
+    {
+        size_t at = first_slot + slot * slot_words;
+        if (slot_entry[slot] == no_entry)
+        {
+            words[at] = empty_slot;
+            continue;
+        }
+
+        const entry& e = entries[slot_entry[slot]];
+        words[at] = add_chars(e.key);
+        words[at + 1] = e.key.size();
+        write_value(*e.value, at + 2);
+    }
+}
+
+template <class Allocator>
+inline frozen_json::frozen_json(const basic_json<Allocator>& doc)
+{
+    builder b;
+    b.reserve(node_words);
+    b.write_value(doc, 0);
+
+    // nodes first, then the string bytes, all in one allocation
+    _chars = b.words.size();
+    _words = _chars + (b.chars.size() + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+    _block.reset(new std::uint64_t[_words]());
+
+    std::memcpy(_block.get(), b.words.data(), b.words.size() * sizeof(std::uint64_t));
+    std::memcpy(_block.get() + _chars, b.chars.data(), b.chars.size());
+}
+
+inline std::uint64_t frozen_json::hash(std::string_view key, std::uint64_t seed)
+{
+    // FNV-1a followed by a 64 bit finalizer so both halves are well mixed
+    std::uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline size_t frozen_json::slot_of(std::uint64_t h, std::uint32_t displacement, size_t slots)
+{
+    // every displacement gives an independent slot, so a free one is always reachable
+    std::uint64_t x = h ^ (displacement * 0x9E3779B97F4A7C15ULL);
+    x ^= x >> 29;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 32;
+    return static_cast<size_t>(x % slots);
+}
+
+inline std::string_view frozen_json::chars(std::uint64_t offset, std::uint64_t length) const
+{
+    const char* base = reinterpret_cast<const char*>(_block.get() + _chars);
+    return std::string_view(base + offset, static_cast<size_t>(length));
+}
+
+inline frozen_json::value frozen_json::root() const
+{
+    return value(this, 0);
+}
+
+inline frozen_json::value frozen_json::operator [](std::string_view key) const
+{
+    return root()[key];
+}
+
+inline frozen_json::value frozen_json::operator [](const char * key) const
+{
+    return root()[std::string_view(key)];
+}
+
+inline frozen_json::value frozen_json::operator [](int index) const
+{
+    return root()[index];
+}
+
+inline const json_t frozen_json::value::type() const
+{
+    return static_cast<json_t>(_doc->word(_node) & 0xFF);
+}
+
+inline const std::string frozen_json::value::type_name() const
+{
+    switch (type())
+    {
+        case json_t::string:
+            return "string";
+        case json_t::array:
+            return "array";
+        case json_t::object:
+            return "object";
+        case json_t::number_double:
+        case json_t::number_integer:
+            return "number";
+        case json_t::boolean:
+            return "boolean";
+        case json_t::null:
+            return "null";
+        default:
+            return "invalid";
+    }
+}
+
+inline const std::string frozen_json::value::get_string() const
+{
+    return std::string(get_string_view());
+}
+
+inline std::string_view frozen_json::value::get_string_view() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::string);
+    return _doc->chars(payload(), count());
+}
+
+inline const long long frozen_json::value::get_integer() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::number_integer);
+    return static_cast<long long>(payload());
+}
+
+inline const double frozen_json::value::get_double() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::number_double);
+    std::uint64_t bits = payload();
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+inline const bool frozen_json::value::get_bool() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::boolean);
+    return payload() != 0;
+}
+
+inline const void* frozen_json::value::get_null() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::null);
+    return nullptr;
+}
+
+inline size_t frozen_json::value::size() const
+{
+    if (type() == json_t::array || type() == json_t::object)
+    {
+        return static_cast<size_t>(count());
+    }
+
+    throw std::runtime_error("Unexpeced json type " + type_name() + ", expected array or object");
+}
+
+inline bool frozen_json::value::has_member(std::string_view key) const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::object);
+    return find(key).has_value();
+}
+
+inline std::optional<frozen_json::value> frozen_json::value::find(std::string_view key) const
+{
+    if (type() != json_t::object || count() == 0)
+    {
+        return std::nullopt;
+    }
+
+    size_t header = static_cast<size_t>(payload());
+    std::uint64_t layout = _doc->word(header + 1);
+    size_t buckets = static_cast<size_t>(layout & 0xFFFFFFFFULL);
+    size_t slots = static_cast<size_t>(layout >> 32);
+
+    std::uint64_t h = hash(key, _doc->word(header));
+    size_t bucket = (h >> 40) % buckets;
+    auto displacement = static_cast<std::uint32_t>(_doc->word(header + 2 + bucket / 2) >> (32 * (bucket % 2)));
+
+    size_t slot = header + 2 + (buckets + 1) / 2 + slot_of(h, displacement, slots) * slot_words;
+    std::uint64_t key_offset = _doc->word(slot);
+    if (key_offset == empty_slot || _doc->chars(key_offset, _doc->word(slot + 1)) != key)
+    {
+        return std::nullopt;
+    }
+
+    return value(_doc, slot + 2);
+}
+
+inline frozen_json::value frozen_json::value::operator [](std::string_view key) const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::object);
+
+    auto member = find(key);
+    if (!member)
+    {
+        throw std::runtime_error("key " + std::string(key) + " not found.");
+    }
+
+    return *member;
+}
+
+inline frozen_json::value frozen_json::value::operator [](int index) const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::array);
+
+    if (index < 0 || (std::uint64_t)index >= count())
+    {
+        throw std::runtime_error("index " + std::to_string(index) + " out of range.");
+    }
+
+    return value(_doc, static_cast<size_t>(payload()) + index * node_words);
+}
+
+template <class Allocator>
+inline frozen_json basic_json<Allocator>::freeze() const
+{
+    return frozen_json(*this);
+}
+
+//
+// tape_document: a parsed document stored as a flat tape of 64 bit words plus one
+// buffer holding every string, so the whole document costs exactly two allocations
+// and a traversal reads memory front to back.
+//
+// Tape layout, the low 8 bits of the first word of a value are its json_t:
+//   null, boolean          one word, a boolean keeps its value in bit 8
+//   number_integer/double  the tag word, then the 64 bit value
+//   string                 the tag word with the length in bits 8-63, then the offset
+//                          into the string buffer
+//   array, object          one word: the element count in bits 8-31 (saturated at
+//                          max_count) and the index just past the container in
+//                          bits 32-63, followed by the elements, or the key string
+//                          and the value of every member
+//
+// The end index lets a container be skipped in O(1). Both buffers are sized from the
+// input length, since a value never takes more words than it has characters.
+//
+class tape_document
+{
+public:
+    class element;
+    class iterator;
+
+    static tape_document parse(std::string_view text);
+
+    tape_document(tape_document&& other) noexcept = default;
+    tape_document& operator= (tape_document&& other) noexcept = default;
+
+    element root() const;
+    element operator [](std::string_view key) const;
+    element operator [](const char * key) const;
+    element operator [](int index) const;
+
+    // number of words written to the tape
+    size_t tape_size() const { return _words; }
+
+private:
+    struct reader;
+
+    static constexpr std::uint64_t max_count = 0xFFFFFF;
+
+    tape_document() = default;
+
+    std::uint64_t word(size_t index) const { return _tape[index]; }
+    size_t next(size_t index) const;
+
+    std::unique_ptr<std::uint64_t[]> _tape;
+    std::unique_ptr<char[]> _strings;
+    size_t _words = 0;
+};
+
+//
+// a view of one value on the tape, valid as long as the tape_document lives
+//
+class tape_document::element
+{
+public:
+    const json_t type() const;
+    const std::string type_name() const;
+
+    const std::string get_string() const;
+    std::string_view get_string_view() const;
+    const long long get_integer() const;
+    const double get_double() const;
+    const bool get_bool() const;
+    const void* get_null() const;
+
+    // walks the elements of an array, or the member values of an object
+    iterator begin() const;
+    iterator end() const;
+
+    size_t size() const;
+    bool has_member(std::string_view key) const;
+    // non-throwing lookup, the element is empty when the member is missing
+    std::optional<element> find(std::string_view key) const;
+
+    element operator [](std::string_view key) const;
+    element operator [](const char * key) const { return (*this)[std::string_view(key)]; }
+    element operator [](int index) const;
+
+private:
+    friend class tape_document;
+    friend class iterator;
+
+    element(const tape_document* doc, size_t index) : _doc(doc), _index(index) {}
+
+    std::uint64_t tag() const { return _doc->word(_index); }
+    size_t first() const { return _index + 1; }
+    size_t last() const { return static_cast<size_t>(tag() >> 32); }
+
+    const tape_document* _doc;
+    size_t _index;
+};
+
+class tape_document::iterator
+{
+public:
+    element operator *() const { return element(_doc, _index); }
+    // the member name, when walking an object
+    std::string_view key() const { return element(_doc, _key).get_string_view(); }
+
+    iterator& operator ++();
+    bool operator ==(const iterator& other) const { return _index == other._index; }
+    bool operator !=(const iterator& other) const { return _index != other._index; }
+
+private:
+    friend class element;
+
+    iterator(const tape_document* doc, size_t index, size_t end, bool members);
+    void step(size_t at);
+
+    const tape_document* _doc;
+    // the current value, and its key when walking an object
+    size_t _index;
+    size_t _key;
+    size_t _end;
+    bool _members;
+};
+
+//
+// single pass UTF-8 parser writing straight to the tape
+//
+struct tape_document::reader
+{
+    const char* p;
+    const char* end;
+    std::uint64_t* tape;
+    size_t words;
+    size_t capacity;
+    char* strings;
+    size_t chars;
+
+    void push(std::uint64_t w)
+    {
+        if (words == capacity)
+        {
+            throw std::runtime_error("invalid json format");
+        }
+        tape[words++] = w;
+    }
+
+    int peek_next_non_space()
+    {
+        while (p != end && std::isspace(static_cast<unsigned char>(*p)))
+        {
+            p++;
+        }
+        return p == end ? EOF : static_cast<unsigned char>(*p);
+    }
+
+    void skip_char(char expected)
+    {
+        if (peek_next_non_space() != static_cast<unsigned char>(expected))
+        {
+            throw std::runtime_error(std::string("expected char '") + expected + "' not found");
+        }
+        p++;
+    }
+
+    void parse_value();
+    void parse_container(json_t type, char close);
+    void parse_string();
+    void parse_number();
+    void parse_literal();
+    bool match_literal(const char* start, std::string_view literal) const;
+    unsigned parse_hex();
+    void append_utf8(char32_t c);
+};
+
+inline void tape_document::reader::parse_value()
+{
+    switch (peek_next_non_space())
+    {
+        case '\"':
+            return parse_string();
+
+        case '[':
+            return parse_container(json_t::array, ']');
+
+        case '{':
+            return parse_container(json_t::object, '}');
+
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+        case '-':
+        case '.':
+            return parse_number();
+
+        case 'T':
+        case 't':
+        case 'F':
+        case 'f':
+        case 'N':
+        case 'n':
+            return parse_literal();
+
+        default:
+            throw std::runtime_error("unexpected character");
+    }
+}
+
+inline void tape_document::reader::parse_container(json_t type, char close)
+{
+    // the container word is completed once its end is known
+    size_t at = words;
+    push(0);
+    p++;
+
+    std::uint64_t count = 0;
+    if (peek_next_non_space() == static_cast<unsigned char>(close))
+    {
+        p++;
+    }
+    else
+    {
+        while (true)
+        {
+            if (type == json_t::object)
+            {
+                if (peek_next_non_space() != '\"')
+                {
+                    throw std::runtime_error("invalid object format");
+                }
+                parse_string();
+                skip_char(':');
+            }
+            parse_value();
+            count++;
+
+            int c = peek_next_non_space();
+            p++;
+            if (c == static_cast<unsigned char>(close))
+            {
+                break;
+            }
+            if (c != ',')
+            {
+                throw std::runtime_error(type == json_t::object ? "invalid object format" : "invalid array format");
+            }
+        }
+    }
+
+    tape[at] = static_cast<std::uint64_t>(type) | (std::min(count, max_count) << 8) | (static_cast<std::uint64_t>(words) << 32);
+}
+
+inline void tape_document::reader::parse_string()
+{
+    // skip the open double quote
+    p++;
+    size_t start = chars;
+
+    while (true)
+    {
+        const char* run = p;
+        while (p != end && *p != '\"' && *p != '\\')
+        {
+            p++;
+        }
+        std::memcpy(strings + chars, run, p - run);
+        chars += p - run;
+
+        if (p == end)
+        {
+            throw std::runtime_error("expected char '\"' not found");
+        }
+        if (*p++ == '\"')
+        {
+            break;
+        }
+        if (p == end)
+        {
+            throw std::runtime_error("backslash is followed by invalid character");
+        }
+
+        switch (*p++)
+        {
+            case '\"': strings[chars++] = '\"'; break;
+            case '\\': strings[chars++] = '\\'; break;
+            case '/': strings[chars++] = '/'; break;
+            case 'b': strings[chars++] = '\b'; break;
+            case 'f': strings[chars++] = '\f'; break;
+            case 'n': strings[chars++] = '\n'; break;
+            case 'r': strings[chars++] = '\r'; break;
+            case 't': strings[chars++] = '\t'; break;
+
+            case 'u':
+            {
+                char32_t c = parse_hex();
+                // a high surrogate followed by a low one encodes a single code point
+                if (c >= 0xD800 && c < 0xDC00)
+                {
+                    if (end - p < 6 || p[0] != '\\' || p[1] != 'u')
+                    {
+                        throw std::runtime_error("high surrogate is not followed by a low one");
+                    }
+                    p += 2;
+                    char32_t low = parse_hex();
+                    if (low < 0xDC00 || low >= 0xE000)
+                    {
+                        throw std::runtime_error("high surrogate is not followed by a low one");
+                    }
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (c >= 0xDC00 && c < 0xE000)
+                {
+                    throw std::runtime_error("low surrogate without a high one");
+                }
+                append_utf8(c);
+                break;
+            }
+
+            default:
+                throw std::runtime_error("backslash is followed by invalid character");
+        }
+    }
+
+    push(static_cast<std::uint64_t>(json_t::string) | (static_cast<std::uint64_t>(chars - start) << 8));
+    push(start);
+}
+
+inline unsigned tape_document::reader::parse_hex()
+{
+    // 4 hex numbers
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++, p++)
+    {
+        if (p == end || !std::isxdigit(static_cast<unsigned char>(*p)))
+        {
+            throw std::runtime_error("not hex number");
+        }
+        char c = static_cast<char>(std::tolower(static_cast<unsigned char>(*p)));
+        value = value * 16 + (c <= '9' ? c - '0' : c - 'a' + 10);
+    }
+    return value;
+}
+
+inline void tape_document::reader::append_utf8(char32_t c)
+{
+    // never longer than the escape sequence it replaces
+    if (c < 0x80)
+    {
+        strings[chars++] = static_cast<char>(c);
+    }
+    else if (c < 0x800)
+    {
+        strings[chars++] = static_cast<char>(0xC0 | (c >> 6));
+        strings[chars++] = static_cast<char>(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000)
+    {
+        strings[chars++] = static_cast<char>(0xE0 | (c >> 12));
+        strings[chars++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        strings[chars++] = static_cast<char>(0x80 | (c & 0x3F));
+    }
+    else
+    {
+        strings[chars++] = static_cast<char>(0xF0 | (c >> 18));
+        strings[chars++] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        strings[chars++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        strings[chars++] = static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+inline void tape_document::reader::parse_number()
+{
+    const char* start = p;
+    bool integer = true;
+    while (p != end && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' ||
+                        *p == '.' || *p == 'e' || *p == 'E'))
+    {
+        integer = integer && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-');
+        p++;
+    }
+
+    // try integer first, if not then double
+    std::uint64_t bits;
+    if (integer)
+    {
+        long long num = 0;
+        auto result = std::from_chars(start, p, num);
+        if (result.ec != std::errc() || result.ptr != p)
+        {
+            throw std::runtime_error("Unexpected number(integer) format.");
+        }
+        push(json_t::number_integer);
+        bits = static_cast<std::uint64_t>(num);
+    }
+    else
+    {
+        // strtod needs a terminated copy, which only a very long number allocates
+        char buffer[64];
+        std::string long_number;
+        const char* nums = buffer;
+        size_t length = p - start;
+        if (length < sizeof(buffer))
+        {
+            std::memcpy(buffer, start, length);
+            buffer[length] = '\0';
+        }
+        else
+        {
+            long_number.assign(start, p);
+            nums = long_number.c_str();
+        }
+
+        char* num_end = nullptr;
+        double num = std::strtod(nums, &num_end);
+        if (num_end != nums + length)
+        {
+            throw std::runtime_error("Unexpected number(double) format.");
+        }
+        push(json_t::number_double);
+        std::memcpy(&bits, &num, sizeof(bits));
+    }
+    push(bits);
+}
+
+inline void tape_document::reader::parse_literal()
+{
+    const char* start = p;
+    while (p != end && std::isalpha(static_cast<unsigned char>(*p)))
+    {
+        p++;
+    }
+
+    // literals are case insensitive, like in the json parser
+    if (match_literal(start, "true"))
+    {
+        push(static_cast<std::uint64_t>(json_t::boolean) | (1 << 8));
+    }
+    else if (match_literal(start, "false"))
+    {
+        push(json_t::boolean);
+    }
+    else if (match_literal(start, "null"))
+    {
+        push(json_t::null);
+    }
+    else
+    {
+        throw std::runtime_error("invalid boolean string");
+    }
+}
+
+inline bool tape_document::reader::match_literal(const char* start, std::string_view literal) const
+{
+    if (static_cast<size_t>(p - start) != literal.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < literal.size(); i++)
+    {
+        if (std::tolower(static_cast<unsigned char>(start[i])) != literal[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline tape_document tape_document::parse(std::string_view text)
+{
+    tape_document doc;
+    // a value has at least as many characters as it takes words (the last number of an
+    // unterminated document excepted), and unescaped strings are never longer than the input
+    size_t capacity = text.size() + 2;
+    doc._tape.reset(new std::uint64_t[capacity]);
+    doc._strings.reset(new char[text.size() + 1]);
+
+    reader r{text.data(), text.data() + text.size(), doc._tape.get(), 0, capacity, doc._strings.get(), 0};
+
+    int first_char = r.peek_next_non_space();
+    if (first_char != '{' && first_char != '[')
+    {
+        throw std::runtime_error("invalid json format");
+    }
+    r.parse_value();
+
+    // Expecting EOF
+    if (r.peek_next_non_space() != EOF)
+    {
+        throw std::runtime_error("invalid json format");
+    }
+
+    doc._words = r.words;
+    return doc;
+}
+
+inline size_t tape_document::next(size_t index) const
+{
+    switch (static_cast<json_t>(_tape[index] & 0xFF))
+    {
+        case json_t::array:
+        case json_t::object:
+            return static_cast<size_t>(_tape[index] >> 32);
+
+        case json_t::string:
+        case json_t::number_integer:
+        case json_t::number_double:
+            return index + 2;
+
+        default:
+            return index + 1;
+    }
+}
+
+inline tape_document::element tape_document::root() const
+{
+    return element(this, 0);
+}
+
+inline tape_document::element tape_document::operator [](std::string_view key) const
+{
+    return root()[key];
+}
+
+inline tape_document::element tape_document::operator [](const char * key) const
+{
+    return root()[std::string_view(key)];
+}
+
+inline tape_document::element tape_document::operator [](int index) const
+{
+    return root()[index];
+}
+
+inline tape_document::iterator::iterator(const tape_document* doc, size_t index, size_t end, bool members)
+    : _doc(doc), _index(index), _key(index), _end(end), _members(members)
+{
+    step(index);
+}
+
+inline tape_document::iterator& tape_document::iterator::operator ++()
+{
+    step(_doc->next(_index));
+    return *this;
+}
+
+inline void tape_document::iterator::step(size_t at)
+{
+    _index = at;
+    if (_members && at != _end)
+    {
+        // a member is its key string followed by the value
+        _key = at;
+        _index = _doc->next(at);
+    }
+}
+
+inline const json_t tape_document::element::type() const
+{
+    return static_cast<json_t>(tag() & 0xFF);
+}
+
+inline const std::string tape_document::element::type_name() const
+{
+    switch (type())
+    {
+        case json_t::string:
+            return "string";
+        case json_t::array:
+            return "array";
+        case json_t::object:
+            return "object";
+        case json_t::number_double:
+        case json_t::number_integer:
+            return "number";
+        case json_t::boolean:
+            return "boolean";
+        case json_t::null:
+            return "null";
+        default:
+            return "invalid";
+    }
+}
+
+inline const std::string tape_document::element::get_string() const
+{
+    return std::string(get_string_view());
+}
+
+inline std::string_view tape_document::element::get_string_view() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::string);
+    return std::string_view(_doc->_strings.get() + _doc->word(_index + 1), static_cast<size_t>(tag() >> 8));
+}
+
+inline const long long tape_document::element::get_integer() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::number_integer);
+    return static_cast<long long>(_doc->word(_index + 1));
+}
+
+inline const double tape_document::element::get_double() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::number_double);
+    std::uint64_t bits = _doc->word(_index + 1);
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+inline const bool tape_document::element::get_bool() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::boolean);
+    return (tag() >> 8) != 0;
+}
+
+inline const void* tape_document::element::get_null() const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::null);
+    return nullptr;
+}
+
+inline tape_document::iterator tape_document::element::begin() const
+{
+    if (type() != json_t::array && type() != json_t::object)
+    {
+        throw std::runtime_error("Unexpeced json type " + type_name() + ", expected array or object");
+    }
+
+    return iterator(_doc, first(), last(), type() == json_t::object);
+}
+
+inline tape_document::iterator tape_document::element::end() const
+{
+    if (type() != json_t::array && type() != json_t::object)
+    {
+        throw std::runtime_error("Unexpeced json type " + type_name() + ", expected array or object");
+    }
+
+    return iterator(_doc, last(), last(), false);
+}
+
+inline size_t tape_document::element::size() const
+{
+    if (type() != json_t::array && type() != json_t::object)
+    {
+        throw std::runtime_error("Unexpeced json type " + type_name() + ", expected array or object");
+    }
+
+    size_t count = static_cast<size_t>((tag() >> 8) & max_count);
+    if (count < max_count)
+    {
+        return count;
+    }
+
+    // the count is saturated, walk the container
+    count = 0;
+    for (auto it = begin(), e = end(); it != e; ++it)
+    {
+        count++;
+    }
+    return count;
+}
+
+inline bool tape_document::element::has_member(std::string_view key) const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::object);
+    return find(key).has_value();
+}
+
+inline std::optional<tape_document::element> tape_document::element::find(std::string_view key) const
+{
+    if (type() != json_t::object)
+    {
+        return std::nullopt;
+    }
+
+    for (auto it = begin(), e = end(); it != e; ++it)
+    {
+        if (it.key() == key)
+        {
+            return *it;
+        }
+    }
+
+    return std::nullopt;
+}
+
+inline tape_document::element tape_document::element::operator [](std::string_view key) const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::object);
+
+    auto member = find(key);
+    if (!member)
+    {
+        throw std::runtime_error("key " + std::string(key) + " not found.");
+    }
+
+    return *member;
+}
+
+inline tape_document::element tape_document::element::operator [](int index) const
+{
+    CHECK_TYPE_MISMATCH(type(), json_t::array);
+
+    // elements have no fixed size, so the ones before index are skipped over
+    size_t at = first();
+    size_t stop = last();
+    for (int i = 0; i < index && at != stop; i++)
+    {
+        at = _doc->next(at);
+    }
+
+    if (index < 0 || at == stop)
+    {
+        throw std::runtime_error("index " + std::to_string(index) + " out of range.");
+    }
+
+    return element(_doc, at);
+}
+
+//
+// basic_shared_document: publishes immutable snapshots of a document to any number of
+// reader threads, read-copy-update style. A reader pins the current snapshot without
+// locks or retries. A writer swaps a new snapshot in with one atomic exchange, then
+// frees the previous one once every reader that could have seen it is done. Writers
+// are serialized; readers never wait for them.
+//
+// Writers do wait for readers, so a thread must not call store() or update() while it
+// holds a snapshot from read() of any shared document: it could wait for itself, or
+// for a writer on another thread that waits for it. Copies from load() are not
+// snapshots and can be kept across writes.
+//
+template <class Allocator = std::allocator<char>>
+class basic_shared_document
+{
+public:
+    using json_type = basic_json<Allocator>;
+    class snapshot;
+
+    explicit basic_shared_document(json_type doc);
+    ~basic_shared_document();
+
+    basic_shared_document(const basic_shared_document&) = delete;
+    basic_shared_document& operator= (const basic_shared_document&) = delete;
+
+    // pins the current snapshot until the returned guard goes away, keep it short:
+    // a writer waits for the snapshots it replaced. Release it before writing to any
+    // shared document.
+    snapshot read() const;
+    // a copy of the current snapshot to keep as long as needed, O(1) as payloads are shared
+    json_type load() const;
+
+    // publishes doc, returns once the previous snapshot is freed. Never returns if the
+    // calling thread holds a snapshot of any shared document.
+    void store(json_type doc);
+    // publishes a modified copy of the current snapshot, waiting like store()
+    template <class Modify>
+    void update(Modify&& modify);
+
+private:
+    // readers spread over cache lines, and over two epochs so the ones a writer
+    // waits for cannot be joined by new readers forever
+    static constexpr size_t stripes = 16;
+
+    struct alignas(64) reader_count
+    {
+        std::atomic<size_t> value{0};
+    };
+
+    static size_t stripe();
+    void publish(json_type* next);
+
+    std::atomic<json_type*> _current;
+    std::atomic<size_t> _epoch{0};
+    mutable reader_count _readers[2][stripes];
+    std::mutex _writer;
+};
 
-        case (json_t::number_double):
-            if (o._type == number_double)
-            {
-                const double* a = static_cast<double*>(_value);
-                const double* b = static_cast<double*>(o._value);
-                return *a == *b;
-            }
+using shared_document = basic_shared_document<>;
 
-        default:
-            return false;
+template <class Allocator>
+class basic_shared_document<Allocator>::snapshot
+{
+public:
+    snapshot(snapshot&& other) noexcept : _count(other._count), _doc(other._doc) { other._count = nullptr; }
+    snapshot& operator= (snapshot&&) = delete;
+    ~snapshot()
+    {
+        if (_count != nullptr)
+        {
+            _count->fetch_sub(1, std::memory_order_release);
+        }
     }
-}
 
-inline bool json::operator!=(const json& o) const
-{
-    return ! (*this == o);
-}
+    const json_type& operator *() const { return *_doc; }
+    const json_type* operator ->() const { return _doc; }
 
-//
-// belows method are for retrieving json values
-//
-inline const std::string json::get_string() const
-{
-    CHECK_TYPE_MISMATCH(this->_type, json_t::string);
-    return *static_cast<std::string*>(_value);
-}
+private:
+    friend class basic_shared_document;
 
-inline const long long json::get_integer() const
-{
-    CHECK_TYPE_MISMATCH(this->_type, json_t::number_integer);
-    return *static_cast<long long*>(_value);
-}
+    snapshot(std::atomic<size_t>* count, const json_type* doc) : _count(count), _doc(doc) {}
 
-inline const double json::get_double() const
-{
-    CHECK_TYPE_MISMATCH(this->_type, json_t::number_double);
-    return *static_cast<double*>(_value);
-}
+    std::atomic<size_t>* _count;
+    const json_type* _doc;
+};
 
-inline const bool json::get_bool() const
+template <class Allocator>
+inline basic_shared_document<Allocator>::basic_shared_document(json_type doc)
+    : _current(new json_type(std::move(doc)))
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::boolean);
-    return *static_cast<bool*>(_value);
 }
 
-inline const json_object json::get_object() const
+template <class Allocator>
+inline basic_shared_document<Allocator>::~basic_shared_document()
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
-    return *static_cast<json_object*>(_value);
+    delete _current.load();
 }
 
-inline const json_array json::get_array() const
+template <class Allocator>
+inline size_t basic_shared_document<Allocator>::stripe()
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
-    return *static_cast<json_array*>(_value);
+    static thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % stripes;
+    return index;
 }
 
-inline const void* json::get_null() const
+template <class Allocator>
+inline typename basic_shared_document<Allocator>::snapshot basic_shared_document<Allocator>::read() const
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::null);
-    return nullptr;
+    // the count is raised before the pointer is read, so a writer that swapped the
+    // pointer earlier either sees this reader or this reader sees the new pointer
+    std::atomic<size_t>& count = _readers[_epoch.load() & 1][stripe()].value;
+    count.fetch_add(1);
+    return snapshot(&count, _current.load());
 }
 
-inline bool json::has_member(std::string member_name)
+template <class Allocator>
+inline typename basic_shared_document<Allocator>::json_type basic_shared_document<Allocator>::load() const
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
-    auto members = static_cast<json_object*>(_value);
-    return (members->find(member_name) != members->end());
+    return *read();
 }
 
-inline void json::add_member(std::string member_name, json member_value)
+template <class Allocator>
+inline void basic_shared_document<Allocator>::store(json_type doc)
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
-    auto members = static_cast<json_object*>(_value);
-    (*members)[member_name] = member_value;
-}
+    std::unique_ptr<json_type> next(new json_type(std::move(doc)));
 
-inline void json::add_element(json elem)
-{
-    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
-    auto elems = static_cast<json_array*>(_value);
-    elems->push_back(elem);
+    std::lock_guard<std::mutex> lock(_writer);
+    publish(next.release());
 }
 
-inline size_t json::size() const
+template <class Allocator>
+template <class Modify>
+inline void basic_shared_document<Allocator>::update(Modify&& modify)
 {
-    if (_type == json_t::array)
-    {
-        auto array = static_cast<json_array*>(_value);
-        return array->size();
-    }
-    else if (_type == json_t::object)
-    {
-        auto members = static_cast<json_object*>(_value);
-        return members->size();
-    }
+    std::lock_guard<std::mutex> lock(_writer);
 
-    throw std::runtime_error("Unexpeced json type " + type_name() + ", expected array or object");
+    // writers are serialized, so the current snapshot cannot be freed under us
+    std::unique_ptr<json_type> next(new json_type(*_current.load()));
+    modify(*next);
+    publish(next.release());
 }
 
-// operator [] for object value
-inline json& json::operator [](const char * key)
+template <class Allocator>
+inline void basic_shared_document<Allocator>::publish(json_type* next)
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::object);
+    std::unique_ptr<json_type> previous(_current.exchange(next));
 
-    json_object* members = static_cast<json_object*>(_value);
-    if (members->find(key) == members->end())
+    // grace period: readers of the previous snapshot raised a count before the
+    // exchange. Flipping the epoch sends new readers to the other counts, so each
+    // set drains; after both have been empty once, no reader holds the previous one.
+    for (int phase = 0; phase < 2; phase++)
     {
-        throw std::runtime_error("key " + std::string(key) + " not found.");
+        size_t draining = _epoch.fetch_add(1) & 1;
+        for (auto& count : _readers[draining])
+        {
+            while (count.value.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
     }
-
-    return (*members)[key];
 }
 
-// operator [int] for array value
-inline json& json::operator[](int index)
+//
+// basic_reclaimer: frees retired documents on a thread of its own, so a request does not
+// wait for a large tree to be taken apart. The allocator of the retired values must
+// allow freeing from another thread. Everything retired is freed by the time the
+// reclaimer is destroyed.
+//
+template <class Allocator = std::allocator<char>>
+class basic_reclaimer
 {
-    CHECK_TYPE_MISMATCH(this->_type, json_t::array);
+public:
+    using json_type = basic_json<Allocator>;
 
-    json_array* array = static_cast<json_array*>(_value);
-    if (index < 0 || (size_t)index >= array->size())
-    {
-        throw std::runtime_error("index " + std::to_string(index) + " out of range.");
-    }
+    basic_reclaimer();
+    ~basic_reclaimer();
 
-    return (*array)[index];
-}
+    basic_reclaimer(const basic_reclaimer&) = delete;
+    basic_reclaimer& operator= (const basic_reclaimer&) = delete;
 
-/// destructor
-inline json::~json()
+    // takes value over in O(1), value is left null
+    void retire(json_type&& value);
+    // waits until everything retired so far is freed
+    void drain();
+
+private:
+    void run();
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    std::vector<json_type> _retired;
+    bool _busy = false;
+    bool _stopping = false;
+    // started last, once the members it uses exist
+    std::thread _worker;
+};
+
+using reclaimer = basic_reclaimer<>;
+
+template <class Allocator>
+inline basic_reclaimer<Allocator>::basic_reclaimer()
+    : _worker([this]() { run(); })
 {
-    switch (_type)
-    {
-        case (json_t::array):
-            delete static_cast<json_array*>(_value);
-            break;
-        case (json_t::object):
-            delete static_cast<json_object*>(_value);
-            break;
-        case (json_t::string):
-            delete static_cast<std::string*>(_value);
-            break;
-        case (json_t::boolean):
-            delete static_cast<bool*>(_value);
-            break;
-        case (json_t::number_double):
-            delete static_cast<double*>(_value);
-            break;
-        case (json_t::number_integer):
-            delete static_cast<long long*>(_value);
-            break;
-        default:
-            break;
-    }
 }
 
-/// Conversion
-inline json::operator const std::string() const
+template <class Allocator>
+inline basic_reclaimer<Allocator>::~basic_reclaimer()
 {
-    switch (_type)
     {
-        case json_t::string:
-            return *static_cast<std::string*>(_value);
-        default:
-            throw std::runtime_error("cannot cast " + type_name() + " to json string");
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
     }
+    _wake.notify_one();
+    _worker.join();
 }
 
-inline json::operator const double() const
+template <class Allocator>
+inline void basic_reclaimer<Allocator>::retire(json_type&& value)
 {
-    switch (_type)
     {
-        case json_t::number_double:
-            return *static_cast<double*>(_value);
-        default:
-            throw std::runtime_error("cannot cast " + type_name() + " to json number");
+        std::lock_guard<std::mutex> lock(_mutex);
+        _retired.push_back(std::move(value));
     }
+    _wake.notify_one();
 }
 
-inline json::operator const long long() const
+template <class Allocator>
+inline void basic_reclaimer<Allocator>::drain()
 {
-    switch (_type)
-    {
-        case json_t::number_integer:
-            return (long long)(*static_cast<long long*>(_value));
-        default:
-            throw std::runtime_error("cannot cast " + type_name() + " to json number");
-    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]() { return _retired.empty() && !_busy; });
 }
 
-inline json::operator const bool() const
+template <class Allocator>
+inline void basic_reclaimer<Allocator>::run()
 {
-    switch (_type)
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
     {
-        case json_t::boolean:
-            return *static_cast<bool*>(_value);
-        default:
-            throw std::runtime_error("cannot cast " + type_name() + " to json boolean");
+        _wake.wait(lock, [this]() { return _stopping || !_retired.empty(); });
+        if (_retired.empty())
+        {
+            return;
+        }
+
+        std::vector<json_type> batch;
+        batch.swap(_retired);
+        _busy = true;
+
+        lock.unlock();
+        batch.clear();
+        lock.lock();
+
+        _busy = false;
+        _idle.notify_all();
     }
 }
 
-inline const std::string json::to_string() const
-{
-    switch(type())
-    {
-        case json_t::object:
-            return object_to_string();
+template <class Allocator = std::allocator<char>>
+class basic_parser;
 
-        case json_t::array:
-            return this->array_to_string();
+//
+// basic_interner: hash-consing of json values. intern() returns a copy of a value that
+// shares its payload with the equal value interned first, so a string, array or object
+// that occurs many times is stored once, and comparing two such values stops at their
+// common payload. Values are interned bottom-up: an array or object is matched by the
+// cells of its children, which are interned already.
+// Interned values are ordinary json values, modifying one gives it its own payload.
+//
+template <class Allocator = std::allocator<char>>
+class basic_interner
+{
+public:
+    using json_type = basic_json<Allocator>;
+    using allocator_type = typename json_type::allocator_type;
 
-        case json_t::string:
-            return "\"" + get_string() + "\"";
+    explicit basic_interner(const allocator_type& alloc = allocator_type());
 
-        case json_t::number_integer:
-            return std::to_string(get_integer());
+    // value with its strings, arrays and objects, at every depth, replaced by interned ones
+    json_type intern(json_type value);
 
-        case json_t::number_double:
-            return std::to_string(get_double());
+    // distinct values held
+    size_t size() const { return _values.size(); }
+    allocator_type get_allocator() const { return allocator_type(_values.get_allocator()); }
+    // drops the interner's references, interned values keep sharing their payloads
+    void clear() { _values.clear(); }
 
-        case json_t::boolean:
-            return get_bool() ? "true" : "false";
+private:
+    friend class basic_parser<Allocator>;
 
-        case json_t::null:
-            return "null";
+    struct content_hash
+    {
+        size_t operator()(const json_type& j) const { return j.hash(); }
+    };
 
-        default:
-            throw std::runtime_error("invalid json type");
-    }
-}
+    struct same_content
+    {
+        bool operator()(const json_type& a, const json_type& b) const { return a.same_interned(b); }
+    };
 
-inline const std::string json::object_to_string() const
-{
-    std::stringstream ss;
-    ss << "{";
+    // value as it is, its children must be interned already
+    json_type intern_node(json_type&& value);
 
-    json_object jobj = get_object();
-    for(auto it = jobj.begin(); it != jobj.end(); it++ )
-    {
-        ss << "\"" << it->first.c_str() << "\"" ;
+    std::unordered_set<json_type, content_hash, same_content,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<json_type>> _values;
+};
 
-        ss << " : " ;
+using interner = basic_interner<>;
 
-        ss << it->second.to_string().c_str();
+template <class Allocator>
+inline basic_interner<Allocator>::basic_interner(const allocator_type& alloc)
+    : _values(0, content_hash(), same_content(),
+              typename std::allocator_traits<allocator_type>::template rebind_alloc<json_type>(alloc))
+{
+}
 
-        if (std::next(it) != jobj.end())
+template <class Allocator>
+inline typename basic_interner<Allocator>::json_type basic_interner<Allocator>::intern(json_type value)
+{
+    if (value.type() == json_t::object)
+    {
+        for (auto& member : value.items())
+        {
+            member.second = intern(std::move(member.second));
+        }
+    }
+    else if (value.type() == json_t::array &&
+             !value.template is_packed<long long>() && !value.template is_packed<double>())
+    {
+        for (auto& elem : value)
         {
-            ss << ",";
+            elem = intern(std::move(elem));
         }
     }
 
-    ss << "}";
-    return ss.str();
+    return intern_node(std::move(value));
 }
 
-inline const std::string json::array_to_string() const
+template <class Allocator>
+inline typename basic_interner<Allocator>::json_type basic_interner<Allocator>::intern_node(json_type&& value)
 {
-    std::stringstream ss;
-    ss << "[";
-
-    json_array jarray = get_array();
-    for(auto it = jarray.begin(); it != jarray.end(); it++ )
+    switch (value.type())
     {
-        ss << it->to_string().c_str();
-
-        if (std::next(it) != jarray.end())
-        {
-            ss << ",";
-        }
+        case json_t::string:
+            if (value.get_string_view().size() <= json_type::short_string_capacity)
+            {
+                return std::move(value);
+            }
+            break;
+        case json_t::array:
+        case json_t::object:
+            break;
+        default:
+            // scalars live in their cell
+            return std::move(value);
     }
 
-    ss << "]";
-
-    return ss.str();
+    return *_values.insert(std::move(value)).first;
 }
 
 //
 //  The Parser
 //
-class parser
+template <class Allocator>
+class basic_parser
 {
 public:
+    using json_type = basic_json<Allocator>;
+    using allocator_type = typename json_type::allocator_type;
+    using string_t = typename json_type::string_t;
+    using array_t = typename json_type::array_t;
+    using object_t = typename json_type::object_t;
+    using integer_array_t = typename json_type::integer_array_t;
+    using double_array_t = typename json_type::double_array_t;
+    using interner_type = basic_interner<Allocator>;
+
+// shorter numeric arrays, such as coordinate pairs, are cheaper as json elements
+static constexpr size_t min_packed_size = 8;
+
+// element counts of the arrays of a document in the order they open, so every array
+// is reserved once instead of growing element by element
+struct size_hints
+{
+    std::vector<size_t> counts;
+    size_t next = 0;
+
+    size_t take() { return next < counts.size() ? counts[next++] : 0; }
+};
 
-static json parse(const char* s)
+static json_type parse(const char* s, const allocator_type& alloc = allocator_type())
 {
+    return parse_document(s, alloc, nullptr);
+}
+
+// parses with every string, array and object interned as soon as it is complete,
+// so repeated ones are stored once from the start
+static json_type parse(const char* s, interner_type& interner)
+{
+    return parse_document(s, interner.get_allocator(), &interner);
+}
+
+static json_type parse_document(const char* s, const allocator_type& alloc, interner_type* interner)
+{
+    size_hints hints = index_arrays(s);
+
     // take UTF8 input and convert to UTF32
     // so we can read char by char for parsing
     std::stringstream sstrm(s);
@@ -632,16 +5705,16 @@ static json parse(const char* s)
     std::wbuffer_convert<std::codecvt_utf8<char32_t>, char32_t> conv(sstrm.rdbuf());
     u32_istream u32strm(&conv);
 
-    json ret_val;
+    json_type ret_val(alloc);
     char32_t first_char = peek_next_non_space(u32strm);
 
     if (first_char == U'{')
     {
-        ret_val = parse_object(u32strm);
+        ret_val = parse_object(u32strm, alloc, &hints, interner);
     }
     else if(first_char == U'[')
     {
-        ret_val = parse_array(u32strm);
+        ret_val = parse_array(u32strm, alloc, &hints, interner);
     }
     else
     {
@@ -654,18 +5727,102 @@ static json parse(const char* s)
         throw std::runtime_error("invalid json format");
     }
 
-    return ret_val;
+    return interned(std::move(ret_val), interner);
+}
+
+static json_type interned(json_type&& value, interner_type* interner)
+{
+    if (interner != nullptr)
+    {
+        return interner->intern_node(std::move(value));
+    }
+    return std::move(value);
+}
+
+//
+// one pass over the raw text counting the elements of every array, strings are skipped
+// so their brackets and commas do not count. Malformed text only yields poor hints,
+// the parser itself reports the error.
+//
+static size_hints index_arrays(const char* s)
+{
+    constexpr size_t not_array = ~size_t(0);
+
+    size_hints hints;
+    std::vector<size_t> open;
+    bool in_string = false;
+    bool expect_element = false;
+
+    for (const char* p = s; *p != '\0'; p++)
+    {
+        char c = *p;
+        if (in_string)
+        {
+            if (c == '\\' && p[1] != '\0')
+            {
+                p++;
+            }
+            else if (c == '\"')
+            {
+                in_string = false;
+            }
+            continue;
+        }
+
+        if (std::isspace(static_cast<unsigned char>(c)))
+        {
+            continue;
+        }
+
+        if (expect_element && c != ']')
+        {
+            hints.counts[open.back()]++;
+        }
+        expect_element = false;
+
+        switch (c)
+        {
+            case '\"':
+                in_string = true;
+                break;
+
+            case '[':
+                open.push_back(hints.counts.size());
+                hints.counts.push_back(0);
+                expect_element = true;
+                break;
+
+            case '{':
+                open.push_back(not_array);
+                break;
+
+            case ']':
+            case '}':
+                if (!open.empty())
+                {
+                    open.pop_back();
+                }
+                break;
+
+            case ',':
+                expect_element = !open.empty() && open.back() != not_array;
+                break;
+        }
+    }
+
+    return hints;
 }
 
-static json parse_value(u32_istream& strm)
+static json_type parse_value(u32_istream& strm, const allocator_type& alloc = allocator_type(), size_hints* hints = nullptr,
+                             interner_type* interner = nullptr)
 {
     switch(peek_next_non_space(strm))
     {
         case U'\"':
-            return parse_string(strm);
+            return parse_string(strm, alloc);
 
         case U'[':
-            return parse_array(strm);
+            return parse_array(strm, alloc, hints, interner);
 
         case U'0':
         case U'1':
@@ -679,29 +5836,30 @@ static json parse_value(u32_istream& strm)
         case U'9':
         case U'-':
         case U'.':
-            return parse_number(strm);
+            return parse_number(strm, alloc);
 
         case U'{':
-            return parse_object(strm);
+            return parse_object(strm, alloc, hints, interner);
 
         case U'T':
         case U't':
         case U'F':
         case U'f':
-            return parse_bool(strm);
+            return parse_bool(strm, alloc);
 
         case U'n':
         case U'N':
-            return parse_null(strm);
+            return parse_null(strm, alloc);
 
         default:
             throw std::runtime_error("unexpected character");
     }
 }
 
-static json parse_object(u32_istream& strm)
+static json_type parse_object(u32_istream& strm, const allocator_type& alloc = allocator_type(), size_hints* hints = nullptr,
+                              interner_type* interner = nullptr)
 {
-    json return_val(json_object{});
+    json_type return_val(object_t{typename object_t::allocator_type(alloc)});
 
     // skip the first '{' character
     skip_char(strm, U'{');
@@ -711,11 +5869,11 @@ static json parse_object(u32_istream& strm)
     {
         if (c == U'\"')
         {
-            std::string member = parse_member(strm);
+            string_t member = parse_member(strm, alloc);
 
             skip_char(strm, U':');
 
-            return_val.add_member(member, parse_value(strm));
+            return_val.add_member(std::move(member), interned(parse_value(strm, alloc, hints, interner), interner));
         }
         else if (c == U'}')
         {
@@ -739,7 +5897,7 @@ static json parse_object(u32_istream& strm)
     return return_val;
 }
 
-static std::string parse_member(u32_istream& strm)
+static string_t parse_member(u32_istream& strm, const allocator_type& alloc = allocator_type())
 {
     std::u32string returnVal;
 
@@ -766,12 +5924,16 @@ static std::string parse_member(u32_istream& strm)
     // go past the closing double quote
     skip_char(strm, U'\"');;
 
-    return U32ToU8(returnVal);
+    return to_string_t(U32ToU8(returnVal), alloc);
 }
 
-static json parse_array(u32_istream& strm)
+static json_type parse_array(u32_istream& strm, const allocator_type& alloc = allocator_type(), size_hints* hints = nullptr,
+                             interner_type* interner = nullptr)
 {
-    json_array vector_val;
+    array_t vector_val{typename array_t::allocator_type(alloc)};
+    integer_array_t integers{typename integer_array_t::allocator_type(alloc)};
+    double_array_t doubles{typename double_array_t::allocator_type(alloc)};
+    size_t hint = hints != nullptr ? hints->take() : 0;
 
     // Go past the opening '['
     skip_char(strm, U'[');
@@ -781,12 +5943,63 @@ static json parse_array(u32_istream& strm)
     if (c == U']')
     {
         skip_char(strm, U']');
-        return json(vector_val);
+        return json_type(std::move(vector_val));
     }
 
+    // numbers are packed until the first value of another type, then the
+    // array continues as json elements
+    bool may_pack = hints == nullptr || hint >= min_packed_size;
+    json_t kind = json_t::invalid;
     do
     {
-        vector_val.push_back(parse_value(strm));
+        json_type elem = interned(parse_value(strm, alloc, hints, interner), interner);
+        if (kind == json_t::invalid)
+        {
+            kind = may_pack && (elem.type() == json_t::number_integer || elem.type() == json_t::number_double)
+                ? elem.type() : json_t::array;
+
+            if (kind == json_t::number_integer)
+            {
+                integers.reserve(hint);
+            }
+            else if (kind == json_t::number_double)
+            {
+                doubles.reserve(hint);
+            }
+            else
+            {
+                vector_val.reserve(hint);
+            }
+        }
+
+        if (kind == json_t::number_integer && elem.type() == kind)
+        {
+            integers.push_back(elem.get_integer());
+        }
+        else if (kind == json_t::number_double && elem.type() == kind)
+        {
+            doubles.push_back(elem.get_double());
+        }
+        else
+        {
+            if (kind != json_t::array)
+            {
+                vector_val.reserve(hint);
+                for (long long val : integers)
+                {
+                    vector_val.emplace_back(val, alloc);
+                }
+                for (double val : doubles)
+                {
+                    vector_val.emplace_back(val, alloc);
+                }
+                integers.clear();
+                doubles.clear();
+                kind = json_t::array;
+            }
+            vector_val.push_back(std::move(elem));
+        }
+
         c = peek_next_non_space(strm);
 
         if (c == U',')
@@ -803,11 +6016,29 @@ static json parse_array(u32_istream& strm)
     // skip the closing square bracket
     skip_char(strm, U']');
 
-    json array_val(vector_val);
+    if (kind == json_t::number_integer && integers.size() >= min_packed_size)
+    {
+        return json_type(std::move(integers));
+    }
+    if (kind == json_t::number_double && doubles.size() >= min_packed_size)
+    {
+        return json_type(std::move(doubles));
+    }
+
+    for (long long val : integers)
+    {
+        vector_val.emplace_back(val, alloc);
+    }
+    for (double val : doubles)
+    {
+        vector_val.emplace_back(val, alloc);
+    }
+
+    json_type array_val(std::move(vector_val));
     return array_val;
 }
 
-static json parse_bool(u32_istream& strm)
+static json_type parse_bool(u32_istream& strm, const allocator_type& alloc = allocator_type())
 {
     std::u32string val_str;
 
@@ -822,11 +6053,11 @@ static json parse_bool(u32_istream& strm)
     std::string bool_str = trim(U32ToU8(val_str));
 
     bool val_bool = to_bool(bool_str);
-    json return_val(val_bool);
+    json_type return_val(val_bool, alloc);
     return return_val;
 }
 
-static json parse_null(u32_istream& strm)
+static json_type parse_null(u32_istream& strm, const allocator_type& alloc = allocator_type())
 {
     std::u32string val_str;
 
@@ -842,7 +6073,7 @@ static json parse_null(u32_istream& strm)
 
     if (null_str == "null")
     {
-        return json();
+        return json_type(alloc);
     }
     else
     {
@@ -850,7 +6081,7 @@ static json parse_null(u32_istream& strm)
     }
 }
 
-static json parse_string(u32_istream& strm)
+static json_type parse_string(u32_istream& strm, const allocator_type& alloc = allocator_type())
 {
     std::u32string string_val;
 
@@ -878,11 +6109,11 @@ static json parse_string(u32_istream& strm)
     // skip the closing double quote
     skip_char(strm, U'\"');
 
-    json return_val(U32ToU8(string_val));
+    json_type return_val(to_string_t(U32ToU8(string_val), alloc));
     return return_val;
 }
 
-static json parse_number(u32_istream& strm)
+static json_type parse_number(u32_istream& strm, const allocator_type& alloc = allocator_type())
 {
     std::u32string num_str;
 
@@ -899,15 +6130,28 @@ static json parse_number(u32_istream& strm)
     // try integer first, if not then double
     if(nums.find_first_not_of("0123456789-") == std::string::npos)
     {
-        return json(to_integer(nums));
+        return json_type(to_integer(nums), alloc);
     }
     else
     {
-        return json(to_double(nums));
+        return json_type(to_double(nums), alloc);
     }
 
 }
 
+static string_t to_string_t(std::string&& str, const allocator_type& alloc)
+{
+    if constexpr (std::is_same<string_t, std::string>::value)
+    {
+        (void)alloc;
+        return std::move(str);
+    }
+    else
+    {
+        return string_t(str.data(), str.size(), alloc);
+    }
+}
+
 static bool to_bool(std::string str)
 {
     std::transform(
@@ -942,13 +6186,19 @@ static long long to_integer(std::string str)
 
 static double to_double(std::string str)
 {
-    size_t pos = 0;
-    double num = std::stod(str, &pos);
+    // not stod, which throws on the ERANGE that strtod reports for subnormals, exact as they are
+    char* end = nullptr;
+    errno = 0;
+    double num = std::strtod(str.c_str(), &end);
 
-    if (pos != str.size())
+    if (str.empty() || end != str.c_str() + str.size())
     {
         throw std::runtime_error("Unexpected number(double) format.");
     }
+    if (errno == ERANGE && std::isinf(num))
+    {
+        throw std::runtime_error("Number(double) out of range.");
+    }
 
     return num;
 }
@@ -995,6 +6245,25 @@ static char32_t escape_char(u32_istream& strm)
 
         case U'u':
             c = parse_hex(strm);
+
+            // a high surrogate followed by a low one encodes a single code point
+            if (c >= 0xD800 && c < 0xDC00)
+            {
+                if (strm.get() != U'\\' || strm.get() != U'u')
+                {
+                    throw std::runtime_error("high surrogate is not followed by a low one");
+                }
+                char32_t low = parse_hex(strm);
+                if (low < 0xDC00 || low >= 0xE000)
+                {
+                    throw std::runtime_error("high surrogate is not followed by a low one");
+                }
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if (c >= 0xDC00 && c < 0xE000)
+            {
+                throw std::runtime_error("low surrogate without a high one");
+            }
             break;
 
         default:
@@ -1050,15 +6319,18 @@ static void skip_space(u32_istream& strm)
 
 static char32_t parse_hex(u32_istream& strm)
 {
-    std::u32string cs;
-
     // 4 hex numbers
+    char32_t value = 0;
     for(int i = 0; i < 4; i++)
     {
         char32_t c = strm.get();
-        if (c != std::char_traits<char32_t>::eof() && isxdigit(c))
+        if (c >= U'0' && c <= U'9')
+        {
+            value = value * 16 + (c - U'0');
+        }
+        else if ((c | 0x20) >= U'a' && (c | 0x20) <= U'f')
         {
-            cs.push_back(c);
+            value = value * 16 + ((c | 0x20) - U'a' + 10);
         }
         else
         {
@@ -1066,14 +6338,23 @@ static char32_t parse_hex(u32_istream& strm)
         }
     }
 
-    std::basic_stringstream<char32_t> is(cs);
-
-    unsigned int uc;
-    is >> std::hex >> uc;
-
-    return char32_t(uc);
+    return value;
 }
 
 };
 
+using parser = basic_parser<>;
+
 }   // namespace tinyjson
+
+namespace std
+{
+
+// json values as keys of unordered containers
+template <class Allocator>
+struct hash<tinyjson::basic_json<Allocator>>
+{
+    size_t operator()(const tinyjson::basic_json<Allocator>& j) const { return j.hash(); }
+};
+
+}   // namespace std
@@ -3,6 +3,18 @@
 
 #include "catch.hpp"
 #include "..\src\tinyjson.h"
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <limits>
+#include <cstdio>
+#include <random>
+#include <cmath>
+#include <charconv>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // This tells Catch to provide a main() - only do this in one cpp file
 
@@ -379,8 +391,9 @@ TEST_CASE("SimpleJson Serialization")
     REQUIRE(b["_______p5"][2].get_bool() == false);
 
     REQUIRE(b["示例一"].get_bool() == false);
-    REQUIRE(b["你好 hello"].get_string() == "world9");
-    REQUIRE(b["世界__i_^"].get_string() == "你好");
+    // backslashes are escaped, so escape sequences in values and keys come back as written
+    REQUIRE(b["你好 hello"].get_string() == "world\\u0039");
+    REQUIRE(b["世界__\\u0069_\\u005E"].get_string() == "你好");
 
     json c(json_object{});
     REQUIRE(c.to_string() == "{}");
@@ -459,6 +472,1503 @@ TEST_CASE("SimpleJson Json Class Test")
     REQUIRE(e.get_string() == "1984");
 }
 
+TEST_CASE("SimpleJson Compact Layout")
+{
+    REQUIRE(sizeof(json) == 16);
+
+    // 14 bytes fit in the cell, 15 go to the heap
+    json s14("abcdefghijklmn"), s15("abcdefghijklmno");
+    REQUIRE(s14.get_string() == "abcdefghijklmn");
+    REQUIRE(s15.get_string() == "abcdefghijklmno");
+    REQUIRE(s14 != s15);
+
+    json copy14(s14), copy15(s15);
+    REQUIRE(copy14 == s14);
+    REQUIRE(copy15 == s15);
+
+    json moved(std::move(copy15));
+    REQUIRE(moved.get_string() == "abcdefghijklmno");
+    REQUIRE(copy15.type() == json_t::null);
+
+    moved = s14;
+    REQUIRE(moved.get_string() == "abcdefghijklmn");
+
+    json i(-9223372036854775807LL - 1), d(-0.0), b(true);
+    REQUIRE(i.get_integer() == -9223372036854775807LL - 1);
+    REQUIRE(d.get_double() == 0.0);
+    REQUIRE(b.get_bool());
+}
+
+struct alloc_stats
+{
+    size_t allocations = 0;
+    size_t live = 0;
+    size_t bytes = 0;
+};
+
+// stateful allocator without a default constructor, like a per-thread pool
+template <class T>
+struct counting_allocator
+{
+    using value_type = T;
+
+    alloc_stats* stats;
+
+    explicit counting_allocator(alloc_stats* s) : stats(s) {}
+
+    template <class U>
+    counting_allocator(const counting_allocator<U>& other) : stats(other.stats) {}
+
+    T* allocate(size_t n)
+    {
+        stats->allocations++;
+        stats->live++;
+        stats->bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        stats->live--;
+        stats->bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <class U>
+    bool operator==(const counting_allocator<U>& other) const { return stats == other.stats; }
+
+    template <class U>
+    bool operator!=(const counting_allocator<U>& other) const { return stats != other.stats; }
+};
+
+using pool_json = basic_json<counting_allocator<char>>;
+using pool_parser = basic_parser<counting_allocator<char>>;
+
+TEST_CASE("SimpleJson Custom Allocator")
+{
+    alloc_stats stats;
+    {
+        counting_allocator<char> alloc(&stats);
+
+        pool_json j = pool_parser::parse(R"({
+            "name": "a string value long enough to need its own buffer",
+            "values": [1, 2.5, true, null],
+            "nested": {"k": "v"}
+        })", alloc);
+
+        REQUIRE(stats.allocations > 0);
+        REQUIRE(j.get_allocator() == alloc);
+        REQUIRE(j["values"].get_allocator() == alloc);
+        REQUIRE(j["values"][0].get_integer() == 1);
+        REQUIRE(j["values"][1].get_double() == 2.5);
+        REQUIRE(j["nested"]["k"].get_string() == "v");
+
+        pool_json copy(j);
+        REQUIRE(copy == j);
+        REQUIRE(copy.get_allocator() == alloc);
+
+        j["nested"].add_member(pool_json::string_t("k2", alloc), pool_json(42, alloc));
+        REQUIRE(j["nested"].size() == 2);
+        REQUIRE(copy["nested"].size() == 1);
+    }
+    REQUIRE(stats.live == 0);
+
+    // a copy into another pool owns all of its tree, so the first pool can be emptied
+    alloc_stats other_stats;
+    {
+        counting_allocator<char> other(&other_stats);
+        pool_json copy(0, other);
+        pool_json assigned(0, other);
+        {
+            auto source = std::make_unique<pool_json>(pool_parser::parse(R"({
+                "a key long enough to need its own buffer": {"k": "a string value long enough to need its own buffer"},
+                "series": [1, 2, 3, 4, 5, 6, 7, 8, 9, 10],
+                "values": [[1, 2.5], {"x": [true, null]}]
+            })", counting_allocator<char>(&stats)));
+            copy = pool_json(*source, other);
+            assigned = *source;
+        }
+        REQUIRE(stats.live == 0);
+
+        for (const pool_json* doc : {&copy, &assigned})
+        {
+            const pool_json& nested = (*doc)["a key long enough to need its own buffer"];
+            REQUIRE(nested.get_allocator() == other);
+            REQUIRE(nested["k"].get_string() == "a string value long enough to need its own buffer");
+            REQUIRE((*doc)["series"].get_allocator() == other);
+            REQUIRE((*doc)["series"][9].get_integer() == 10);
+            REQUIRE((*doc)["values"][0].get_allocator() == other);
+            REQUIRE((*doc)["values"][1]["x"].get_allocator() == other);
+            REQUIRE((*doc)["values"][1]["x"][0].get_bool() == true);
+            for (const auto& member : doc->get_object())
+            {
+                REQUIRE(member.first.get_allocator() == other);
+            }
+        }
+    }
+    REQUIRE(other_stats.live == 0);
+
+    // the default json does not go through the pool
+    size_t before = stats.allocations;
+    json d = parser::parse(R"({"k": [1, 2, 3]})");
+    REQUIRE(d["k"].size() == 3);
+    REQUIRE(stats.allocations == before);
+}
+
+TEST_CASE("SimpleJson Copy On Write")
+{
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+
+    pool_json a = pool_parser::parse(R"({
+        "list": [1, 2, {"deep": "a string value long enough to need its own buffer"}],
+        "name": "tinyjson"
+    })", alloc);
+
+    // copies share the payload
+    size_t before = stats.allocations;
+    pool_json b(a);
+    pool_json c = b;
+    REQUIRE(stats.allocations == before);
+    REQUIRE(a == b);
+    REQUIRE(b == c);
+
+    // the first mutation clones only the containers on the path
+    b["list"].add_element(pool_json(3, alloc));
+    REQUIRE(stats.allocations > before);
+    REQUIRE(b["list"].size() == 4);
+    REQUIRE(a["list"].size() == 3);
+    REQUIRE(c["list"].size() == 3);
+    REQUIRE(a != b);
+    REQUIRE(a == c);
+
+    b["list"][2].add_member(pool_json::string_t("more", alloc), pool_json(true, alloc));
+    REQUIRE(b["list"][2].size() == 2);
+    REQUIRE(a["list"][2].size() == 1);
+    REQUIRE(a["list"][2]["deep"].get_string() == "a string value long enough to need its own buffer");
+
+    // copies can be made and read from several threads
+    const json shared = parser::parse(R"({"config": {"threads": 8, "name": "a shared read-only configuration"}})");
+    std::vector<std::thread> readers;
+    std::atomic<int> matches{0};
+    for (int t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&shared, &matches]()
+        {
+            for (int i = 0; i < 1000; i++)
+            {
+                json copy(shared);
+                if (copy["config"]["threads"].get_integer() == 8)
+                {
+                    matches++;
+                }
+            }
+        });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(matches == 4000);
+}
+
+TEST_CASE("SimpleJson Const Accessors")
+{
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+
+    const pool_json doc = pool_parser::parse(R"({
+        "short": "on",
+        "long": "a string value long enough to need its own buffer",
+        "list": [1, 2, 3],
+        "members": {"a": 1, "b": 2}
+    })", alloc);
+
+    size_t before = stats.allocations;
+
+    REQUIRE(doc["short"].get_string_view() == "on");
+    REQUIRE(doc["long"].get_string_view() == "a string value long enough to need its own buffer");
+    REQUIRE(&doc["list"].get_array() == &doc["list"].get_array());
+    REQUIRE(&doc["members"].get_object() == &doc["members"].items());
+
+    long long sum = 0;
+    for (auto& elem : doc["list"])
+    {
+        sum += elem.get_integer();
+    }
+    REQUIRE(sum == 6);
+
+    std::string keys;
+    for (auto& [key, value] : doc["members"].items())
+    {
+        keys += key.c_str();
+        sum += value.get_integer();
+    }
+    REQUIRE(keys == "ab");
+    REQUIRE(sum == 9);
+
+    REQUIRE(stats.allocations == before);
+
+    // non-const iteration modifies only this copy
+    pool_json copy(doc);
+    for (auto& elem : copy["list"])
+    {
+        elem = pool_json(0, alloc);
+    }
+    REQUIRE(copy["list"][0].get_integer() == 0);
+    REQUIRE(doc["list"][0].get_integer() == 1);
+
+    REQUIRE_THROWS(doc["short"].begin());
+    REQUIRE_THROWS(doc["list"].items());
+    REQUIRE_THROWS(doc["list"].get_string_view());
+}
+
+TEST_CASE("SimpleJson Member Lookup")
+{
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+
+    const pool_json config = pool_parser::parse(R"({
+        "a_key_longer_than_any_small_string_buffer": {"port": 8080},
+        "name": "service"
+    })", alloc);
+
+    size_t before = stats.allocations;
+
+    std::string_view long_key = "a_key_longer_than_any_small_string_buffer";
+    REQUIRE(config[long_key]["port"].get_integer() == 8080);
+    REQUIRE(config.has_member(long_key));
+    REQUIRE_FALSE(config.has_member("missing"));
+    REQUIRE(config.find("name") != nullptr);
+    REQUIRE(config.find("name")->get_string_view() == "service");
+    REQUIRE(config.find("missing") == nullptr);
+    REQUIRE(config["name"].find("name") == nullptr);
+
+    REQUIRE(stats.allocations == before);
+
+    REQUIRE_THROWS_WITH(config["missing"], Contains("key missing not found"));
+
+    json j = parser::parse(R"({"p1": 1})");
+    std::string key = "p1";
+    REQUIRE(j[key].get_integer() == 1);
+    *j.find(key) = json(2);
+    REQUIRE(j["p1"].get_integer() == 2);
+}
+
+TEST_CASE("SimpleJson Frozen Json")
+{
+    json j = parser::parse(R"({
+        "name": "a string value long enough to need its own buffer",
+        "port": 8080,
+        "ratio": 0.75,
+        "enabled": true,
+        "nothing": null,
+        "empty": {},
+        "servers": [{"host": "a", "weight": 1}, {"host": "b", "weight": 2}, []]
+    })");
+
+    frozen_json f = j.freeze();
+    REQUIRE(f.root().type() == json_t::object);
+    REQUIRE(f.root().size() == 7);
+    REQUIRE(f["name"].get_string() == "a string value long enough to need its own buffer");
+    REQUIRE(f["port"].get_integer() == 8080);
+    REQUIRE(f["ratio"].get_double() == 0.75);
+    REQUIRE(f["enabled"].get_bool() == true);
+    REQUIRE(f["nothing"].get_null() == nullptr);
+    REQUIRE(f["empty"].size() == 0);
+    REQUIRE_FALSE(f["empty"].has_member("name"));
+    REQUIRE(f["servers"].size() == 3);
+    REQUIRE(f["servers"][1]["host"].get_string_view() == "b");
+    REQUIRE(f["servers"][1]["weight"].get_integer() == 2);
+    REQUIRE(f["servers"][2].type() == json_t::array);
+
+    REQUIRE_FALSE(f.root().find("missing").has_value());
+    REQUIRE_THROWS_WITH(f["missing"], Contains("key missing not found"));
+    REQUIRE_THROWS(f["servers"][3]);
+    REQUIRE_THROWS(f["port"].get_string());
+
+    // every key of a large object is found through its perfect hash slot
+    json big(json_object{});
+    for (int i = 0; i < 5000; i++)
+    {
+        big.add_member("key" + std::to_string(i), i);
+    }
+    frozen_json fb(big);
+    bool all_found = true;
+    for (int i = 0; i < 5000; i++)
+    {
+        all_found = all_found && fb["key" + std::to_string(i)].get_integer() == i;
+    }
+    REQUIRE(all_found);
+    REQUIRE_FALSE(fb.root().has_member("key5000"));
+
+    // lock-free concurrent reads
+    std::vector<std::thread> readers;
+    std::atomic<int> matches{0};
+    for (int t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&fb, &matches, t]()
+        {
+            for (int i = t; i < 5000; i += 4)
+            {
+                if (fb["key" + std::to_string(i)].get_integer() == i)
+                {
+                    matches++;
+                }
+            }
+        });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(matches == 5000);
+}
+
+TEST_CASE("SimpleJson Tape Document")
+{
+    tape_document doc = tape_document::parse(R"({
+        "name": "tab\tquote\" \u00e9 \ud83d\ude00",
+        "port": 8080,
+        "ratio": -0.75e1,
+        "enabled": True,
+        "nothing": null,
+        "empty": {},
+        "servers": [{"host": "a", "weight": 1}, {"host": "b", "weight": 2}, []]
+    })");
+
+    REQUIRE(doc.root().type() == json_t::object);
+    REQUIRE(doc.root().size() == 7);
+    REQUIRE(doc["name"].get_string() == "tab\tquote\" \xC3\xA9 \xF0\x9F\x98\x80");
+    REQUIRE(doc["port"].get_integer() == 8080);
+    REQUIRE(doc["ratio"].get_double() == -7.5);
+    REQUIRE(doc["enabled"].get_bool() == true);
+    REQUIRE(doc["nothing"].get_null() == nullptr);
+    REQUIRE(doc["empty"].size() == 0);
+    REQUIRE(doc["empty"].begin() == doc["empty"].end());
+    REQUIRE(doc["servers"].size() == 3);
+    REQUIRE(doc["servers"][1]["host"].get_string_view() == "b");
+    REQUIRE(doc["servers"][1]["weight"].get_integer() == 2);
+    REQUIRE(doc["servers"][2].type() == json_t::array);
+
+    REQUIRE_FALSE(doc.root().find("missing").has_value());
+    REQUIRE_THROWS_WITH(doc["missing"], Contains("key missing not found"));
+    REQUIRE_THROWS(doc["servers"][3]);
+    REQUIRE_THROWS(doc["port"].get_string());
+
+    // members come in document order, containers are skipped over
+    std::vector<std::string> keys;
+    for (auto it = doc.root().begin(); it != doc.root().end(); ++it)
+    {
+        keys.push_back(std::string(it.key()));
+    }
+    REQUIRE(keys == std::vector<std::string>{"name", "port", "ratio", "enabled", "nothing", "empty", "servers"});
+
+    long long weights = 0;
+    for (auto server : doc["servers"])
+    {
+        if (server.type() == json_t::object)
+        {
+            weights += server["weight"].get_integer();
+        }
+    }
+    REQUIRE(weights == 3);
+
+    // the same document through the tree parser
+    json j = parser::parse("[1, 2.5, \"three\", [true, null], {\"k\": []}]");
+    tape_document t = tape_document::parse(j.to_string());
+    REQUIRE(t.root().size() == j.size());
+    REQUIRE(t[1].get_double() == j[1].get_double());
+    REQUIRE(t[2].get_string() == j[2].get_string());
+    REQUIRE(t[3][0].get_bool() == j[3][0].get_bool());
+    REQUIRE(t[4]["k"].size() == 0);
+
+    REQUIRE_THROWS(tape_document::parse("[1, 2"));
+    REQUIRE_THROWS(tape_document::parse("[1 2]"));
+    REQUIRE_THROWS(tape_document::parse("{\"a\" 1}"));
+    REQUIRE_THROWS(tape_document::parse("[[[[["));
+    REQUIRE_THROWS(tape_document::parse("[\"open"));
+    REQUIRE_THROWS(tape_document::parse("[nul]"));
+    REQUIRE_THROWS(tape_document::parse("42"));
+
+    // surrogates only make a character in pairs, as in the tree parser
+    REQUIRE_THROWS_WITH(tape_document::parse(R"(["\ud83d"])"), Contains("low"));
+    REQUIRE_THROWS_WITH(tape_document::parse(R"(["\ud83d\u0041"])"), Contains("low"));
+    REQUIRE_THROWS_WITH(tape_document::parse(R"(["\ude00"])"), Contains("low surrogate"));
+}
+
+TEST_CASE("SimpleJson Emplace And Reserve")
+{
+    json doc(json_object{});
+    json& servers = doc.emplace_member("servers", json_array{});
+    servers.reserve(3);
+    REQUIRE(servers.get_array().capacity() >= 3);
+
+    json& first = servers.emplace_element(json_object{});
+    first.emplace_member("host", "alpha");
+    first.emplace_member("port", 80);
+    servers.emplace_element("a string element long enough to live on the heap");
+    servers.emplace_element(2.5);
+
+    REQUIRE(doc["servers"].size() == 3);
+    REQUIRE(doc["servers"][0]["host"].get_string() == "alpha");
+    REQUIRE(doc["servers"][1].get_string() == "a string element long enough to live on the heap");
+    REQUIRE(doc["servers"][2].get_double() == 2.5);
+
+    // an existing member is replaced, like add_member does
+    json& port = doc["servers"][0].emplace_member("port", 8080);
+    REQUIRE(port.get_integer() == 8080);
+    REQUIRE(doc["servers"][0].size() == 2);
+
+    // copy and move overloads
+    json item("shared");
+    json list(json_array{});
+    list.add_element(item);
+    list.add_element(std::move(item));
+    list.add_element(json(3));
+    REQUIRE(list.size() == 3);
+    REQUIRE(list[1].get_string() == "shared");
+
+    json members(json_object{});
+    json value(1);
+    members.add_member("copied", value);
+    members.add_member("moved", json(2));
+    REQUIRE(members["copied"].get_integer() == 1);
+    REQUIRE(members["moved"].get_integer() == 2);
+
+    // reserving a shared array leaves the copies alone
+    json copy = list;
+    list.reserve(100);
+    list.emplace_element(4);
+    REQUIRE(copy.size() == 3);
+    REQUIRE(list.size() == 4);
+
+    members.reserve(10);
+    REQUIRE_THROWS(json("text").reserve(1));
+    REQUIRE_THROWS(json(1).emplace_element(2));
+    REQUIRE_THROWS(list.emplace_member("key", 1));
+
+    // arrays are counted once before parsing, brackets and commas in strings do not count
+    auto hints = parser::index_arrays(R"([1, "a,] [", [2, 3], [], {"k": [4, {"l": []}]}, [[5]]])");
+    REQUIRE(hints.counts == std::vector<size_t>{6, 2, 0, 2, 0, 1, 1});
+
+    json parsed = parser::parse(R"([1, "a,] [", [2, 3], [], {"k": [4, {"l": []}]}, [[5]]])");
+    REQUIRE(parsed.size() == 6);
+    REQUIRE(parsed.get_array().capacity() == 6);
+    REQUIRE(parsed[4]["k"].size() == 2);
+    REQUIRE(parsed[5][0][0].get_integer() == 5);
+}
+
+TEST_CASE("SimpleJson Packed Arrays")
+{
+    json doc = parser::parse(R"({
+        "ints": [1, 2, 3, 4, 5, 6, 7, 8],
+        "doubles": [0.5, 1.5, -2.25, 3.0, 4.0, 5.0, 6.0, 7.0],
+        "mixed": [1, 2, 3, 4, 5, 6, 7, 8.5],
+        "pair": [1.5, 2.5],
+        "empty": []
+    })");
+
+    const json& ints = doc["ints"];
+    REQUIRE(ints.is_packed<long long>());
+    REQUIRE(ints.size() == 8);
+    auto int_span = ints.as_span<long long>();
+    REQUIRE(std::vector<long long>(int_span.begin(), int_span.end()) == std::vector<long long>{1, 2, 3, 4, 5, 6, 7, 8});
+    REQUIRE(ints.to_string() == "[1,2,3,4,5,6,7,8]");
+
+    const json& doubles = doc["doubles"];
+    REQUIRE(doubles.is_packed<double>());
+    auto double_span = doubles.as_span<double>();
+    REQUIRE(double_span.size() == 8);
+    REQUIRE(double_span[2] == -2.25);
+    REQUIRE_THROWS(doubles.as_span<long long>());
+
+    REQUIRE_FALSE(doc["mixed"].is_packed<long long>());
+    REQUIRE_FALSE(doc["mixed"].is_packed<double>());
+    REQUIRE(doc["mixed"][6].get_integer() == 7);
+    REQUIRE(doc["mixed"][7].get_double() == 8.5);
+    REQUIRE_THROWS(doc["mixed"].as_span<double>());
+    REQUIRE(doc["empty"].as_span<double>().empty());
+
+    // short arrays are cheaper as json elements
+    REQUIRE_FALSE(doc["pair"].is_packed<double>());
+    REQUIRE(doc["pair"][1].get_double() == 2.5);
+
+    // the generic accessors still work, the elements are built once
+    REQUIRE(ints[1].get_integer() == 2);
+    REQUIRE(&ints[1] == &ints.get_array()[1]);
+    long long sum = 0;
+    for (auto& elem : ints)
+    {
+        sum += elem.get_integer();
+    }
+    REQUIRE(sum == 36);
+    REQUIRE(ints == parser::parse("[1, 2, 3, 4, 5, 6, 7, 8]"));
+    REQUIRE(doc["pair"] == json(json_array{json(1.5), json(2.5)}));
+
+    // appending a number of the same kind keeps the array packed, anything else unpacks it
+    json values = parser::parse("[10, 20, 30, 40, 50, 60, 70, 80]");
+    json copy = values;
+    values.add_element(json(90));
+    REQUIRE(values.is_packed<long long>());
+    REQUIRE(values.size() == 9);
+    REQUIRE(copy.size() == 8);
+    REQUIRE(copy.is_packed<long long>());
+
+    values.add_element(json(0.5));
+    REQUIRE_FALSE(values.is_packed<long long>());
+    REQUIRE(values.size() == 10);
+    REQUIRE(values[8].get_integer() == 90);
+    REQUIRE(values[9].get_double() == 0.5);
+
+    // a read loop through a non-const value keeps the array packed, in every copy
+    json series = parser::parse("[1, 2, 3, 4, 5, 6, 7, 8, 9, 10]");
+    json series_copy = series;
+    long long series_sum = 0;
+    for (auto& elem : series)
+    {
+        series_sum += elem.get_integer();
+    }
+    REQUIRE(series_sum == 55);
+    REQUIRE(series.is_packed<long long>());
+    REQUIRE(series_copy.is_packed<long long>());
+    REQUIRE(series.as_span<long long>()[9] == 10);
+
+    // modifying an element unpacks
+    json modified(json::double_array_t{1.0, 2.0});
+    modified[0] = json("first");
+    REQUIRE(modified[0].get_string() == "first");
+    REQUIRE(modified[1].get_double() == 2.0);
+
+    // once the elements were built, appending continues with them
+    json read(json::integer_array_t{4, 5});
+    REQUIRE(std::as_const(read)[0].get_integer() == 4);
+    read.add_element(json(6));
+    REQUIRE_FALSE(read.is_packed<long long>());
+    REQUIRE(read.size() == 3);
+    REQUIRE(read[2].get_integer() == 6);
+
+    // concurrent readers build the elements only once
+    json shared = ints;
+    std::vector<std::thread> readers;
+    std::atomic<long long> total{0};
+    for (int t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&shared, &total]()
+        {
+            for (auto& elem : std::as_const(shared))
+            {
+                total += elem.get_integer();
+            }
+        });
+    }
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(total == 4 * 36);
+
+    frozen_json f = doc.freeze();
+    REQUIRE(f["ints"][2].get_integer() == 3);
+    REQUIRE(f["doubles"][0].get_double() == 0.5);
+
+    // packed arrays can also be built directly
+    json built(json::double_array_t{1.0, 2.0});
+    REQUIRE(built.is_packed<double>());
+    REQUIRE(built.as_span<double>()[1] == 2.0);
+}
+
+TEST_CASE("SimpleJson Short Strings")
+{
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+
+    // short keys and values cost nothing besides the object and its map nodes
+    pool_json doc = pool_parser::parse(R"({"id": "file", "name": "main_window", "value": "on"})", alloc);
+    REQUIRE(stats.live == 1 + 3);
+    REQUIRE(doc["name"].get_string_view() == "main_window");
+
+    pool_json built(pool_json::object_t{pool_json::object_t::allocator_type(alloc)});
+    size_t before = stats.live;
+    built.emplace_member("alignment", "center", alloc);
+    built.add_member(pool_json::string_t("hOffset", alloc), pool_json("a value of 27 bytes or more", alloc));
+    // a map node each, the long value adds its shared payload and buffer
+    REQUIRE(stats.live - before == 2 + 2);
+    REQUIRE(json::short_string_capacity == 14);
+}
+
+TEST_CASE("SimpleJson Memory Usage")
+{
+    REQUIRE(json(1).memory_usage().total == sizeof(json));
+    REQUIRE(json("short").memory_usage().total == sizeof(json));
+    memory_usage_t long_string = json("a string value long enough to need its own buffer").memory_usage();
+    REQUIRE(long_string.strings > 0);
+    REQUIRE(long_string.by_type[json_t::string] == long_string.total);
+
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+
+    pool_json doc = pool_parser::parse(R"({
+        "name": "a string value long enough to need its own buffer",
+        "a key long enough to need its own buffer": "short",
+        "list": [1, "two", 3.5, null, true, {"nested": [[], {}]}],
+        "samples": [0.5, 1.5, 2.5, 3.5, 4.5, 5.5, 6.5, 7.5]
+    })", alloc);
+
+    // every byte the allocator handed out is accounted for
+    memory_usage_t usage = doc.memory_usage();
+    REQUIRE(usage.total == sizeof(pool_json) + stats.bytes);
+    REQUIRE(usage.total == usage.values + usage.strings + usage.keys + usage.containers + usage.packed);
+
+    size_t by_type = 0;
+    for (size_t bytes : usage.by_type)
+    {
+        by_type += bytes;
+    }
+    REQUIRE(by_type == usage.total);
+    REQUIRE(usage.packed == 8 * sizeof(double));
+    REQUIRE(usage.values == 14 * sizeof(pool_json));
+    REQUIRE(usage.by_type[json_t::boolean] == sizeof(pool_json));
+
+    // the elements built for reading a packed array are counted too
+    std::as_const(doc)["samples"].get_array();
+    REQUIRE(doc.memory_usage().total == sizeof(pool_json) + stats.bytes);
+    REQUIRE(doc.memory_usage().containers > usage.containers);
+}
+
+TEST_CASE("SimpleJson Shared Document")
+{
+    shared_document config(parser::parse(R"({"version": 0, "a": 0, "b": 0})"));
+    REQUIRE((*config.read())["version"].get_integer() == 0);
+
+    config.update([](json& doc)
+    {
+        doc["version"] = json(1);
+        doc["a"] = json(1);
+        doc["b"] = json(1);
+    });
+    json kept = config.load();
+    REQUIRE(kept["version"].get_integer() == 1);
+
+    // readers always see one whole version, and never an older one than before
+    const long long versions = 200;
+    std::atomic<bool> done{false};
+    std::atomic<int> inconsistent{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++)
+    {
+        readers.emplace_back([&]()
+        {
+            long long last = 0;
+            while (!done)
+            {
+                auto snapshot = config.read();
+                long long version = (*snapshot)["version"].get_integer();
+                if (version < last || (*snapshot)["a"].get_integer() != version || (*snapshot)["b"].get_integer() != version)
+                {
+                    inconsistent++;
+                }
+                last = version;
+            }
+        });
+    }
+    for (long long v = 2; v <= versions; v++)
+    {
+        if (v % 2 == 0)
+        {
+            json doc(json_object{});
+            doc.emplace_member("version", v);
+            doc.emplace_member("a", v);
+            doc.emplace_member("b", v);
+            config.store(std::move(doc));
+        }
+        else
+        {
+            config.update([v](json& doc)
+            {
+                doc["version"] = json(v);
+                doc["a"] = json(v);
+                doc["b"] = json(v);
+            });
+        }
+    }
+    done = true;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+    REQUIRE(inconsistent == 0);
+    REQUIRE(config.load()["version"].get_integer() == versions);
+    // an earlier copy is unaffected by later versions
+    REQUIRE(kept["version"].get_integer() == 1);
+
+    // a copy from load() is no snapshot, so its thread can go on writing
+    json current = config.load();
+    config.store(json(json_object{}));
+    config.update([](json& doc) { doc.add_member("version", json(0)); });
+    REQUIRE(current["version"].get_integer() == versions);
+    REQUIRE(config.load()["version"].get_integer() == 0);
+}
+
+TEST_CASE("SimpleJson Hash")
+{
+    json a = parser::parse(R"({"name": "a string value long enough to need its own buffer", "list": [1, 2.5, null, true], "n": 3})");
+    json b = parser::parse(R"({"n": 3, "list": [1, 2.5, null, true], "name": "a string value long enough to need its own buffer"})");
+    REQUIRE(a.hash() == b.hash());
+    REQUIRE(std::hash<json>()(a) == a.hash());
+
+    json c = parser::parse(R"({"n": 4, "list": [1, 2.5, null, true], "name": "a string value long enough to need its own buffer"})");
+    REQUIRE(a.hash() != c.hash());
+    REQUIRE(json(1).hash() == json(1.0).hash());
+    REQUIRE(json(1).hash() != json(1.5).hash());
+    REQUIRE(json(json_array{}).hash() != json(json_object{}).hash());
+    REQUIRE(json("1").hash() != json(1).hash());
+
+    // packed and generic arrays of the same numbers hash the same
+    json packed = parser::parse("[1, 2, 3, 4, 5, 6, 7, 8]");
+    REQUIRE(packed.is_packed<long long>());
+    json generic(json_array{});
+    for (int i = 1; i <= 8; i++)
+    {
+        generic.emplace_element(i);
+    }
+    REQUIRE_FALSE(generic.is_packed<long long>());
+    REQUIRE(packed.hash() == generic.hash());
+
+    // modifying a value drops the hash kept for it and for the values holding it
+    size_t before = a.hash();
+    json copy = a;
+    a["list"][0] = json(2);
+    REQUIRE(a.hash() != before);
+    REQUIRE(copy.hash() == before);
+    a["list"][0] = json(1);
+    REQUIRE(a.hash() == before);
+    packed.add_element(json(9));
+    REQUIRE(packed.hash() != generic.hash());
+
+    std::unordered_set<json> seen;
+    seen.insert(a);
+    seen.insert(b);
+    seen.insert(c);
+    REQUIRE(seen.size() == 2);
+}
+
+TEST_CASE("SimpleJson Interner")
+{
+    using pool_interner = basic_interner<counting_allocator<char>>;
+
+    std::string text = "[";
+    for (int i = 0; i < 100; i++)
+    {
+        text += (i > 0 ? "," : "");
+        text += R"({"id": )" + std::to_string(i % 2) + R"(, "address": {"street": "1 Infinite Loop, Cupertino", "zip": "95014"},)"
+                R"( "unit": "a unit name long enough to need a buffer", "dims": [1.5, 2.5, 3.5]})";
+    }
+    text += "]";
+
+    alloc_stats plain_stats;
+    pool_json plain = pool_parser::parse(text.c_str(), counting_allocator<char>(&plain_stats));
+
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+    pool_json doc(alloc);
+    {
+        pool_interner interner(alloc);
+        doc = pool_parser::parse(text.c_str(), interner);
+        // two distinct items, one address, street, unit and dims, and the top array
+        REQUIRE(interner.size() == 2 + 1 + 1 + 1 + 1 + 1);
+    }
+    // the items alternate between two shared objects
+    REQUIRE(stats.live < plain_stats.live / 20);
+    REQUIRE(doc == plain);
+    REQUIRE(doc[0] == doc[2]);
+    REQUIRE(doc[0] != doc[1]);
+
+    // a shared subtree is still modified on its own
+    doc[0]["address"]["zip"] = pool_json("10001", alloc);
+    REQUIRE(doc[0]["address"]["zip"].get_string_view() == "10001");
+    REQUIRE(doc[2]["address"]["zip"].get_string_view() == "95014");
+
+    // interning a built value, equal values of other types or storage stay apart
+    interner values;
+    json a = values.intern(parser::parse(R"({"k": [1, 2], "d": [1.0, 2.0], "s": "a string long enough to be shared"})"));
+    json b = values.intern(parser::parse(R"({"s": "a string long enough to be shared", "k": [1, 2], "d": [1.0, 2.0]})"));
+    REQUIRE(a == b);
+    REQUIRE(values.size() == 4);
+    REQUIRE(values.intern(json("a string long enough to be shared")) == a["s"]);
+    REQUIRE(values.size() == 4);
+}
+
+TEST_CASE("SimpleJson Equality")
+{
+    REQUIRE(json() == json());
+    REQUIRE(json() != json(false));
+    REQUIRE(json(true) != json(1));
+    REQUIRE(json(1) == json(1.0));
+    REQUIRE(json(1.0) == json(1));
+    REQUIRE(json(1) != json(1.5));
+    REQUIRE(json(0.0) == json(-0.0));
+    REQUIRE(json(1) != json("1"));
+    REQUIRE(json("a string value long enough to need its own buffer") == json("a string value long enough to need its own buffer"));
+    REQUIRE(json("short") != json("shorter"));
+    json nan(std::numeric_limits<double>::quiet_NaN());
+    REQUIRE(nan != nan);
+
+    // packed and generic arrays compare by their numbers
+    json packed = parser::parse("[1, 2, 3, 4, 5, 6, 7, 8]");
+    json doubles = parser::parse("[1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0]");
+    REQUIRE(packed.is_packed<long long>());
+    REQUIRE(doubles.is_packed<double>());
+    json generic(json_array{});
+    for (int i = 1; i <= 8; i++)
+    {
+        generic.emplace_element(i);
+    }
+    REQUIRE(packed == doubles);
+    REQUIRE(packed == generic);
+    REQUIRE(generic == doubles);
+    generic.add_element(json(9));
+    REQUIRE(packed != generic);
+
+    const char* text = R"({"a": [1, {"b": null}], "c": "a string value long enough to need its own buffer", "d": true})";
+    json a = parser::parse(text);
+    json b = parser::parse(text);
+    REQUIRE(a == b);
+    b["a"][1]["b"] = json(0);
+    REQUIRE(a != b);
+    REQUIRE(b != a);
+
+    // kept hashes tell different values apart, equal ones are still compared
+    a.hash();
+    b.hash();
+    REQUIRE(a != b);
+    b["a"][1]["b"] = json();
+    REQUIRE(a.hash() == b.hash());
+    REQUIRE(a == b);
+    REQUIRE(parser::parse(R"({"a": 1})") != parser::parse(R"({"b": 1})"));
+    REQUIRE(parser::parse(R"({"a": 1})") != parser::parse(R"({"a": 1, "b": 1})"));
+}
+
+TEST_CASE("SimpleJson Teardown")
+{
+    // nesting this deep would overflow the stack if values freed their children recursively
+    {
+        json deep(json_array{});
+        json* last = &deep;
+        for (int i = 0; i < 1000000; i++)
+        {
+            last = &last->emplace_element(json_array{});
+        }
+        json nested(json_object{});
+        last = &nested;
+        for (int i = 0; i < 1000000; i++)
+        {
+            last = &last->emplace_member("k", json_object{});
+        }
+    }
+
+    alloc_stats stats;
+    counting_allocator<char> alloc(&stats);
+
+    // a subtree still shared with a copy outlives the document
+    pool_json kept(alloc);
+    {
+        pool_json doc = pool_parser::parse(R"({"a": [[1, 2], {"b": [3, "a string long enough for its own buffer"]}], "c": {}})", alloc);
+        kept = doc["a"][1];
+    }
+    REQUIRE(kept["b"][1].get_string_view() == "a string long enough for its own buffer");
+    size_t kept_live = stats.live;
+
+    basic_reclaimer<counting_allocator<char>> background;
+    pool_json doc = pool_parser::parse(R"({"a": [[1, 2], {"b": [3, "a string long enough for its own buffer"]}], "c": {}})", alloc);
+    background.retire(std::move(doc));
+    REQUIRE(doc.type() == json_t::null);
+    background.drain();
+    REQUIRE(stats.live == kept_live);
+}
+
+TEST_CASE("SimpleJson Output Sinks")
+{
+    json doc = parser::parse(R"({"b": [1, 2.5, "x"], "a": null, "c": {"t": true}})");
+    const std::string expected = R"({"a":null,"b":[1,2.5,"x"],"c":{"t":true}})";
+    REQUIRE(doc.to_string() == expected);
+
+    // a string sink appends, and a reused buffer keeps its capacity
+    std::string buffer = "prefix:";
+    {
+        string_sink<> out(buffer);
+        doc.dump(out);
+    }
+    REQUIRE(buffer == "prefix:" + expected);
+    buffer.clear();
+    size_t capacity = buffer.capacity();
+    {
+        string_sink<> out(buffer);
+        doc.dump(out);
+    }
+    REQUIRE(buffer == expected);
+    REQUIRE(buffer.capacity() == capacity);
+
+    std::vector<char> bytes;
+    {
+        string_sink<std::vector<char>> out(bytes);
+        doc.dump(out);
+    }
+    REQUIRE(std::string(bytes.begin(), bytes.end()) == expected);
+
+    char fixed[128];
+    buffer_sink fixed_out(fixed, sizeof(fixed));
+    doc.dump(fixed_out);
+    REQUIRE(std::string(fixed, fixed_out.size()) == expected);
+    char small[16];
+    buffer_sink small_out(small, sizeof(small));
+    REQUIRE_THROWS_WITH(doc.dump(small_out), Contains("full"));
+
+    // more text than a page goes through stream and fd sinks in pieces
+    json big(json_array{});
+    for (int i = 0; i < 2000; i++)
+    {
+        big.emplace_element("a string value long enough to need its own buffer");
+    }
+    std::string big_text = big.to_string();
+
+    std::ostringstream os;
+    {
+        ostream_sink out(os);
+        big.dump(out);
+    }
+    REQUIRE(os.str() == big_text);
+
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+#ifdef _WIN32
+    int fd = _fileno(file);
+#else
+    int fd = fileno(file);
+#endif
+    {
+        fd_sink out(fd);
+        big.dump(out);
+    }
+    std::rewind(file);
+    std::string written(big_text.size() + 1, '\0');
+    written.resize(std::fread(&written[0], 1, written.size(), file));
+    std::fclose(file);
+    REQUIRE(written == big_text);
+}
+
+TEST_CASE("SimpleJson Shortest Doubles")
+{
+    auto shortest = [](double value) {
+        char text[detail::max_double_chars];
+        return std::string(text, detail::format_double(text, value));
+    };
+
+    REQUIRE(shortest(0.1) == "0.1");
+    REQUIRE(shortest(-2.5) == "-2.5");
+    REQUIRE(shortest(100.0) == "100");
+    REQUIRE(shortest(1e21) == "1e+21");
+    REQUIRE(shortest(123456789012345680000.0) == "123456789012345680000");
+    REQUIRE(shortest(0.000001) == "0.000001");
+    REQUIRE(shortest(1e-7) == "1e-7");
+    REQUIRE(shortest(1e-10) == "1e-10");
+    REQUIRE(shortest(1.5e300) == "1.5e+300");
+    REQUIRE(shortest(5e-324) == "5e-324");
+    REQUIRE(shortest(std::numeric_limits<double>::max()) == "1.7976931348623157e+308");
+    REQUIRE(shortest(std::numeric_limits<double>::min()) == "2.2250738585072014e-308");
+    REQUIRE(shortest(0.30000000000000004) == "0.30000000000000004");
+
+    REQUIRE(shortest(9.999999999999997e+22) == "9.999999999999997e+22");
+    REQUIRE(shortest(1316436775194682.2) == "1316436775194682.2");
+
+    // every finite double reads back as itself, with the digits printf rounds to
+    std::mt19937_64 rng(20101015);
+    bool all_round_trip = true;
+    bool all_closest = true;
+    for (int i = 0; i < 200000; i++)
+    {
+        std::uint64_t bits = rng();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        if (!std::isfinite(value))
+        {
+            continue;
+        }
+        std::string text = shortest(value);
+        all_round_trip = all_round_trip && std::strtod(text.c_str(), nullptr) == value && text.size() <= 25;
+
+        char digits[18];
+        char exact[18];
+        int len = 0;
+        int exact_len = 0;
+        int decimal_exponent = 0;
+        int exact_exponent = 0;
+        detail::grisu::shortest_digits(digits, len, decimal_exponent, std::abs(value));
+        detail::grisu::shortest_digits_slow(exact, exact_len, exact_exponent, std::abs(value));
+        all_closest = all_closest && std::string(digits, len) == std::string(exact, exact_len) &&
+                      decimal_exponent == exact_exponent;
+    }
+    REQUIRE(all_round_trip);
+    REQUIRE(all_closest);
+
+    // documents keep a '.' or exponent on doubles, and write nothing JSON cannot read
+    json doc(json_array{});
+    doc.emplace_element(3.0);
+    doc.emplace_element(-0.0);
+    doc.emplace_element(0.1);
+    doc.emplace_element(2e22);
+    doc.emplace_element(std::numeric_limits<double>::infinity());
+    doc.emplace_element(std::nan(""));
+    REQUIRE(doc.to_string() == "[3.0,-0.0,0.1,2e+22,null,null]");
+
+    json back = parser::parse(json(json_array{1.0 / 3, 6.02214076e23, 4.9e-300}).to_string().c_str());
+    REQUIRE(back[0].get_double() == 1.0 / 3);
+    REQUIRE(back[1].get_double() == 6.02214076e23);
+    REQUIRE(back[2].get_double() == 4.9e-300);
+
+    // subnormals read back too, though strtod flags them as underflow
+    json tiny = parser::parse(json(json_array{5e-324, 8.39529643683898e-309, -2.5e-320}).to_string().c_str());
+    REQUIRE(tiny[0].get_double() == 5e-324);
+    REQUIRE(tiny[1].get_double() == 8.39529643683898e-309);
+    REQUIRE(tiny[2].get_double() == -2.5e-320);
+    REQUIRE_THROWS_WITH(parser::parse("[1e400]"), Contains("out of range"));
+}
+
+TEST_CASE("SimpleJson Integer Text")
+{
+    auto text = [](auto value) {
+        char out[detail::max_integer_chars];
+        return std::string(out, detail::format_integer(out, value));
+    };
+
+    REQUIRE(text(0LL) == "0");
+    REQUIRE(text(7LL) == "7");
+    REQUIRE(text(-7LL) == "-7");
+    REQUIRE(text(10LL) == "10");
+    REQUIRE(text(99LL) == "99");
+    REQUIRE(text(100LL) == "100");
+    REQUIRE(text(-1000LL) == "-1000");
+    REQUIRE(text(std::numeric_limits<long long>::max()) == "9223372036854775807");
+    REQUIRE(text(std::numeric_limits<long long>::min()) == "-9223372036854775808");
+    REQUIRE(text(std::numeric_limits<unsigned long long>::max()) == "18446744073709551615");
+
+    // every length, at and around each power of ten, and random bit patterns
+    bool all_match = true;
+    auto matches = [&](auto value) {
+        char expected[24];
+        return text(value) == std::string(expected, std::to_chars(expected, expected + sizeof(expected), value).ptr);
+    };
+    unsigned long long pow10 = 1;
+    for (int digits = 1; digits <= 20; digits++)
+    {
+        for (unsigned long long value : {pow10 - 1, pow10, pow10 + 1, pow10 * 5})
+        {
+            all_match = all_match && matches(value) && matches(static_cast<long long>(value)) &&
+                        matches(-static_cast<long long>(value));
+        }
+        pow10 = (digits < 20) ? pow10 * 10 : pow10;
+    }
+    std::mt19937_64 rng(44);
+    for (int i = 0; i < 100000; i++)
+    {
+        unsigned long long bits = rng() >> (rng() % 64);
+        all_match = all_match && matches(bits) && matches(static_cast<long long>(bits));
+    }
+    REQUIRE(all_match);
+
+    // integers are formatted in place, and still fit when the sink has only a few bytes left
+    json doc(json_array{});
+    doc.emplace_element(std::numeric_limits<long long>::min());
+    doc.emplace_element(json(json_array{1, -22, 333}));
+    doc.emplace_element(std::numeric_limits<long long>::max());
+    const std::string expected = "[-9223372036854775808,[1,-22,333],9223372036854775807]";
+    REQUIRE(doc.to_string() == expected);
+    char exact[54];
+    buffer_sink exact_out(exact, sizeof(exact));
+    doc.dump(exact_out);
+    REQUIRE(std::string(exact, exact_out.size()) == expected);
+}
+
+TEST_CASE("SimpleJson Unicode Escapes")
+{
+    json doc = parser::parse(R"(["world\u0039", "\u4e16\u754C", "\u00e9", "\ud83d\ude00"])");
+    REQUIRE(doc[0].get_string() == "world9");
+    REQUIRE(doc[1].get_string() == "世界");
+    REQUIRE(doc[2].get_string() == "\xC3\xA9");
+    REQUIRE(doc[3].get_string() == "\xF0\x9F\x98\x80");
+
+    // surrogates only make a character in pairs
+    REQUIRE_THROWS_WITH(parser::parse(R"(["\ud83d"])"), Contains("low"));
+    REQUIRE_THROWS_WITH(parser::parse(R"(["\ud83d\u0041"])"), Contains("low"));
+    REQUIRE_THROWS_WITH(parser::parse(R"(["\ude00"])"), Contains("low surrogate"));
+}
+
+TEST_CASE("SimpleJson String Escaping")
+{
+    json doc(json_array{});
+    doc.emplace_element("quote \" backslash \\ slash /");
+    doc.emplace_element("\b\f\n\r\t");
+    doc.emplace_element(std::string("nul \0 unit \x1f del \x7f", 18));
+    doc.emplace_element("世界 \xF0\x9F\x98\x80");
+    REQUIRE(doc.to_string() ==
+            "[\"quote \\\" backslash \\\\ slash /\",\"\\b\\f\\n\\r\\t\",\"nul \\u0000 unit \\u001f del \x7f\","
+            "\"世界 \xF0\x9F\x98\x80\"]");
+
+    std::string ascii;
+    {
+        string_sink<> out(ascii);
+        dump_options options;
+        options.ascii_only = true;
+        doc.dump(out, options);
+    }
+    REQUIRE(ascii.find("\"\\u4e16\\u754c \\ud83d\\ude00\"") != std::string::npos);
+    REQUIRE(std::find_if(ascii.begin(), ascii.end(), [](char c) { return (c & 0x80) != 0; }) == ascii.end());
+
+    // both forms read back as the same strings
+    REQUIRE(parser::parse(doc.to_string().c_str()) == doc);
+    REQUIRE(parser::parse(ascii.c_str()) == doc);
+    REQUIRE(tape_document::parse(ascii).root()[3].get_string() == "世界 \xF0\x9F\x98\x80");
+
+    // malformed UTF-8 is replaced in ASCII only mode
+    json bad(std::string("a\xff" "b\xe4\xb8" "c"));
+    std::string bad_text;
+    {
+        string_sink<> out(bad_text);
+        dump_options options;
+        options.ascii_only = true;
+        bad.dump(out, options);
+    }
+    REQUIRE(bad_text == "\"a\\ufffdb\\ufffd\\ufffdc\"");
+
+    // every position of a long string, on both sides of the 16 byte scan
+    std::string long_text(100, 'x');
+    bool all_escaped = true;
+    for (size_t i = 0; i < long_text.size(); i++)
+    {
+        std::string text = long_text;
+        text[i] = '"';
+        std::string expected = "\"" + long_text.substr(0, i) + "\\\"" + long_text.substr(i + 1) + "\"";
+        all_escaped = all_escaped && json(text).to_string() == expected;
+    }
+    REQUIRE(all_escaped);
+}
+
+TEST_CASE("SimpleJson Pretty Printing")
+{
+    json doc = parser::parse(R"({"name": "tiny", "sizes": [1, 2], "ratios": [0.5], "none": {}, "list": [],
+                                 "nested": {"deep": [true, {"x": null}]}})");
+
+    REQUIRE(doc.to_string() ==
+            R"({"list":[],"name":"tiny","nested":{"deep":[true,{"x":null}]},"none":{},"ratios":[0.5],"sizes":[1,2]})");
+
+    dump_options pretty;
+    pretty.pretty = true;
+    REQUIRE(doc.to_string(pretty) ==
+            "{\n"
+            "    \"list\": [],\n"
+            "    \"name\": \"tiny\",\n"
+            "    \"nested\": {\n"
+            "        \"deep\": [\n"
+            "            true,\n"
+            "            {\n"
+            "                \"x\": null\n"
+            "            }\n"
+            "        ]\n"
+            "    },\n"
+            "    \"none\": {},\n"
+            "    \"ratios\": [\n"
+            "        0.5\n"
+            "    ],\n"
+            "    \"sizes\": [\n"
+            "        1,\n"
+            "        2\n"
+            "    ]\n"
+            "}");
+
+    dump_options tabs;
+    tabs.pretty = true;
+    tabs.indent = 1;
+    tabs.indent_char = '\t';
+    REQUIRE(doc["nested"].to_string(tabs) == "{\n\t\"deep\": [\n\t\ttrue,\n\t\t{\n\t\t\t\"x\": null\n\t\t}\n\t]\n}");
+
+    dump_options flat;
+    flat.pretty = true;
+    flat.indent = 0;
+    json packed = parser::parse("[1, 2, 3, 4, 5, 6, 7, 8]");
+    REQUIRE(packed.is_packed<long long>());
+    REQUIRE(packed.to_string(flat) == "[\n1,\n2,\n3,\n4,\n5,\n6,\n7,\n8\n]");
+    REQUIRE(json(42).to_string(pretty) == "42");
+
+    // indentation deeper than a sink page streams through it in pieces
+    json deep;
+    for (int i = 0; i < 200; i++)
+    {
+        deep = json(json_array{std::move(deep)});
+    }
+    std::ostringstream os;
+    {
+        ostream_sink out(os);
+        deep.dump(out, pretty);
+    }
+    REQUIRE(os.str() == deep.to_string(pretty));
+    REQUIRE(os.str().find("\n" + std::string(800, ' ') + "null\n") != std::string::npos);
+    REQUIRE(parser::parse(os.str().c_str()) == deep);
+}
+
+TEST_CASE("SimpleJson Fd Sink")
+{
+    // long strings go out by reference between pieces of the page, short ones through it
+    json doc(json_array{});
+    for (int i = 0; i < 300; i++)
+    {
+        doc.emplace_element(std::string(100 + i * 37 % 5000, static_cast<char>('a' + i % 26)) + "\"\n" +
+                            std::string(2000, 'z'));
+        doc.emplace_element(i);
+    }
+    const std::string expected = doc.to_string();
+
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+#ifdef _WIN32
+    int fd = _fileno(file);
+#else
+    int fd = fileno(file);
+#endif
+    {
+        fd_sink out(fd);
+        doc.dump(out);
+    }
+    std::rewind(file);
+    std::string written(expected.size() + 1, '\0');
+    written.resize(std::fread(&written[0], 1, written.size(), file));
+    std::fclose(file);
+    REQUIRE(written == expected);
+
+#ifndef _WIN32
+    // a non-blocking pipe fills up long before the document is written; whenever it
+    // does, the wait function empties it, as another thread or an event loop would
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    std::string received;
+    auto drain = [&]() {
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(fds[0], chunk, sizeof(chunk))) > 0)
+        {
+            received.append(chunk, static_cast<size_t>(n));
+        }
+    };
+    int waits = 0;
+    {
+        fd_sink out(fds[1], [&](int) {
+            waits++;
+            drain();
+        });
+        doc.dump(out);
+    }
+    drain();
+    REQUIRE(waits > 0);
+    REQUIRE(received == expected);
+
+    // without a wait function a full pipe is an error
+    {
+        fd_sink out(fds[1]);
+        REQUIRE_THROWS_WITH(doc.dump(out), Contains("not writable"));
+    }
+    close(fds[0]);
+    close(fds[1]);
+#endif
+}
+
+TEST_CASE("SimpleJson Serialized Size")
+{
+    json doc = parser::parse(R"({"name": "tab\there \"quoted\" é😀", "id": -9223372036854775807,
+                                 "ints": [1, 22, -333, 4444, 0, 6, 7, 8], "doubles": [0.5, 1e300, -2.25, 3, 4, 5, 6, 7.0],
+                                 "mixed": [null, true, false, {}, [], 1.0e-7, {"deep": {"deeper": [[]]}}],
+                                 "empty": "", "zero": -0.0})");
+    doc.add_member("control", std::string("\x01\x1f", 2));
+    doc.add_member("special", json(json_array{std::numeric_limits<double>::infinity(), 100.0}));
+
+    dump_options pretty;
+    pretty.pretty = true;
+    dump_options tabs = pretty;
+    tabs.indent = 1;
+    tabs.indent_char = '\t';
+    dump_options ascii;
+    ascii.ascii_only = true;
+    dump_options pretty_ascii = pretty;
+    pretty_ascii.ascii_only = true;
+
+    for (const dump_options& options : {dump_options(), pretty, tabs, ascii, pretty_ascii})
+    {
+        const std::string text = doc.to_string(options);
+        REQUIRE(doc.serialized_size(options) == text.size());
+
+        std::vector<char> buffer(doc.serialized_size(options));
+        char* end = doc.serialize_to(buffer.data(), buffer.size(), options);
+        REQUIRE(end == buffer.data() + buffer.size());
+        REQUIRE(std::string(buffer.data(), buffer.size()) == text);
+    }
+
+    for (const json& scalar : {json(), json(true), json(false), json(0), json(-1), json(1234567890123LL),
+                                json(0.1), json("short"), json(std::string(100, '"'))})
+    {
+        REQUIRE(scalar.serialized_size() == scalar.to_string().size());
+    }
+
+    char small[8];
+    REQUIRE_THROWS_WITH(doc.serialize_to(small, sizeof(small)), Contains("full"));
+}
+
+TEST_CASE("SimpleJson Canonical Text")
+{
+    auto canonical = [](const json& j) {
+        std::string text;
+        {
+            string_sink<> out(text);
+            j.dump_canonical(out);
+        }
+        return text;
+    };
+    auto hex = [](const sha256_sink::digest_type& digest) {
+        static const char digits[] = "0123456789abcdef";
+        std::string text;
+        for (std::uint8_t byte : digest)
+        {
+            text += digits[byte >> 4];
+            text += digits[byte & 0xF];
+        }
+        return text;
+    };
+
+    // RFC 8785, 3.2.2
+    json doc = parser::parse(R"({
+        "numbers": [333333333.33333329, 1E30, 4.50, 2e-3, 0.000000000000000000000000001],
+        "string": "\u20ac$\u000F\u000aA'\u0042\u0022\u005c\\\"\/",
+        "literals": [null, true, false]
+    })");
+    REQUIRE(canonical(doc) ==
+            "{\"literals\":[null,true,false],\"numbers\":[333333333.3333333,1e+30,4.5,0.002,1e-27],"
+            "\"string\":\"\xE2\x82\xAC$\\u000f\\nA'B\\\"\\\\\\\\\\\"/\"}");
+
+    // RFC 8785, 3.2.3: keys in UTF-16 order, which puts U+1F600 before U+FB33
+    json keys = parser::parse(R"({"\u20ac": 1, "\r": 2, "\ufb33": 3, "1": 4, "\ud83d\ude00": 5, "\u0080": 6, "\u00f6": 7})");
+    REQUIRE(canonical(keys) ==
+            "{\"\\r\":2,\"1\":4,\"\xC2\x80\":6,\"\xC3\xB6\":7,\"\xE2\x82\xAC\":1,\"\xF0\x9F\x98\x80\":5,\"\xEF\xAC\xB3\":3}");
+
+    // RFC 8785, appendix B
+    auto number = [&](std::uint64_t bits) {
+        double val;
+        std::memcpy(&val, &bits, sizeof(val));
+        return canonical(json(val));
+    };
+    REQUIRE(number(0x0000000000000000) == "0");
+    REQUIRE(number(0x8000000000000000) == "0");
+    REQUIRE(number(0x0000000000000001) == "5e-324");
+    REQUIRE(number(0x8000000000000001) == "-5e-324");
+    REQUIRE(number(0x7fefffffffffffff) == "1.7976931348623157e+308");
+    REQUIRE(number(0x4340000000000000) == "9007199254740992");
+    REQUIRE(number(0x444b1ae4d6e2ef50) == "1e+21");
+    REQUIRE(number(0x3eb0c6f7a0b5ed8d) == "0.000001");
+    REQUIRE(number(0x3eb0c6f7a0b5ed8c) == "9.999999999999997e-7");
+    REQUIRE(number(0x44b52d02c7e14af5) == "9.999999999999997e+22");
+    REQUIRE(number(0x44b52d02c7e14af6) == "1e+23");
+    REQUIRE(canonical(json(1316436775194682.2)) == "1316436775194682.2");
+    REQUIRE(canonical(json(8.4816206987030405e+18)) == "8481620698703040000");
+    REQUIRE(canonical(parser::parse("[9007199254740993, -42, [1, 2, 3, 4, 5, 6, 7, 8]]")) ==
+            "[9007199254740992,-42,[1,2,3,4,5,6,7,8]]");
+    REQUIRE_THROWS_WITH(canonical(json(std::nan(""))), Contains("canonical"));
+
+    // the order of insertion, or of parsing, does not change the text
+    json a = parser::parse(R"({"b": [1, {"y": 2, "x": 1}], "a": "\u00e9"})");
+    json b(json_object{});
+    b.add_member("a", "\xC3\xA9");
+    b.add_member("b", json(json_array{1, parser::parse(R"({"x": 1.0, "y": 2})")}));
+    REQUIRE(canonical(a) == canonical(b));
+
+    // FIPS 180-4 examples
+    sha256_sink sha;
+    REQUIRE(hex(sha.digest()) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    sha.write("abc");
+    REQUIRE(hex(sha.digest()) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    sha.write("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+    REQUIRE(hex(sha.digest()) == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    for (int i = 0; i < 1000; i++)
+    {
+        sha.write(std::string(1000, 'a'));
+    }
+    REQUIRE(hex(sha.digest()) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    // hashing as the text streams by gives the hash of the text
+    a.dump_canonical(sha);
+    const auto streamed = sha.digest();
+    sha.write(canonical(b));
+    REQUIRE(streamed == sha.digest());
+}
+
+TEST_CASE("SimpleJson Writer")
+{
+    auto write = [](const dump_options& options) {
+        std::string text;
+        string_sink<> out(text);
+        json_writer writer(out, options);
+        writer.begin_object()
+            .key("active").value(true)
+            .key("empty").begin_array().end_array()
+            .key("id").value(42)
+            .key("name").value("tab\there")
+            .key("nested").begin_object()
+                .key("big").value(std::numeric_limits<unsigned long long>::max())
+                .key("none").null()
+                .key("scores").begin_array().value(0.5).value(-3LL).value(std::string_view("x")).end_array()
+            .end_object()
+            .key("object").begin_object().end_object()
+        .end_object();
+        REQUIRE(writer.complete());
+        writer.flush();
+        return text;
+    };
+
+    // the same text as the value would have
+    json doc = parser::parse(R"({"active": true, "empty": [], "id": 42, "name": "tab\there",
+                                 "nested": {"big": 0, "none": null, "scores": [0.5, -3, "x"]}, "object": {}})");
+    std::string expected = doc.to_string();
+    expected.replace(expected.find("\"big\":0"), 7, "\"big\":18446744073709551615");
+    REQUIRE(write(dump_options()) == expected);
+
+    dump_options pretty;
+    pretty.pretty = true;
+    std::string expected_pretty = doc.to_string(pretty);
+    expected_pretty.replace(expected_pretty.find("\"big\": 0"), 8, "\"big\": 18446744073709551615");
+    REQUIRE(write(pretty) == expected_pretty);
+
+    // a top level scalar, and integers of every width
+    std::string text;
+    {
+        string_sink<> out(text);
+        json_writer writer(out);
+        writer.begin_array().value(short(-1)).value(7u).value(8L).value('A').value(1.0).end_array();
+    }
+    REQUIRE(text == "[-1,7,8,65,1.0]");
+
+#ifndef NDEBUG
+    std::string ignored;
+    string_sink<> out(ignored);
+    REQUIRE_THROWS_WITH(json_writer(out).begin_object().value(1), Contains("key first"));
+    REQUIRE_THROWS_WITH(json_writer(out).begin_array().key("a"), Contains("key belongs"));
+    REQUIRE_THROWS_WITH(json_writer(out).begin_object().key("a").key("b"), Contains("key belongs"));
+    REQUIRE_THROWS_WITH(json_writer(out).begin_object().end_array(), Contains("end_array"));
+    REQUIRE_THROWS_WITH(json_writer(out).begin_array().end_object(), Contains("end_object"));
+    REQUIRE_THROWS_WITH(json_writer(out).begin_object().key("a").end_object(), Contains("end_object"));
+    REQUIRE_THROWS_WITH(json_writer(out).end_array(), Contains("end_array"));
+    REQUIRE_THROWS_WITH(json_writer(out).value(1).value(2), Contains("single top level"));
+    REQUIRE_FALSE(json_writer(out).begin_array().complete());
+#endif
+}
+
 TEST_CASE("SimpleJson Nubmer Parsing Failure")
 {
     u32_sstream ns1(U"0.124abc");